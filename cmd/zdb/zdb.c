@@ -8865,6 +8865,20 @@ mos_leak_log_spacemaps(spa_t *spa)
 		mos_obj_refd(sls->sls_sm_obj);
 }
 
+static void
+mos_leak_arc_warm(spa_t *spa)
+{
+	uint64_t ent[2];
+	int error = zap_lookup(spa_meta_objset(spa),
+	    DMU_POOL_DIRECTORY_OBJECT, DMU_POOL_ARC_WARM,
+	    sizeof (uint64_t), 2, ent);
+	if (error == ENOENT)
+		return;
+	ASSERT0(error);
+
+	mos_obj_refd(ent[0]);
+}
+
 static void
 errorlog_count_refd(objset_t *mos, uint64_t errlog)
 {
@@ -8919,6 +8933,7 @@ dump_mos_leaks(spa_t *spa)
 	if (spa->spa_syncing_log_sm != NULL)
 		mos_obj_refd(spa->spa_syncing_log_sm->sm_object);
 	mos_leak_log_spacemaps(spa);
+	mos_leak_arc_warm(spa);
 
 	mos_obj_refd(spa->spa_condensing_indirect_phys.
 	    scip_next_mapping_object);
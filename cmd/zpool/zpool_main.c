@@ -243,6 +243,8 @@ static const char *vsx_type_to_nvlist[IOS_COUNT][15] = {
 	    ZPOOL_CONFIG_VDEV_TOT_W_LAT_HISTO,
 	    ZPOOL_CONFIG_VDEV_DISK_R_LAT_HISTO,
 	    ZPOOL_CONFIG_VDEV_DISK_W_LAT_HISTO,
+	    ZPOOL_CONFIG_VDEV_POLL_R_LAT_HISTO,
+	    ZPOOL_CONFIG_VDEV_POLL_W_LAT_HISTO,
 	    ZPOOL_CONFIG_VDEV_SYNC_R_LAT_HISTO,
 	    ZPOOL_CONFIG_VDEV_SYNC_W_LAT_HISTO,
 	    ZPOOL_CONFIG_VDEV_ASYNC_R_LAT_HISTO,
@@ -4754,6 +4756,7 @@ typedef struct iostat_cbdata {
 typedef struct name_and_columns {
 	const char *name;	/* Column name */
 	unsigned int columns;	/* Center name to this number of columns */
+	boolean_t poll;		/* Column of an optional poll histogram */
 } name_and_columns_t;
 
 #define	IOSTAT_MAX_LABELS	15	/* Max number of labels on one line */
@@ -4768,8 +4771,9 @@ static const name_and_columns_t iostat_top_labels[][IOSTAT_MAX_LABELS] =
 	[IOS_QUEUES] = {{"syncq_read", 2}, {"syncq_write", 2},
 	    {"asyncq_read", 2}, {"asyncq_write", 2}, {"scrubq_read", 2},
 	    {"trimq_write", 2}, {"rebuildq_write", 2}, {NULL}},
-	[IOS_L_HISTO] = {{"total_wait", 2}, {"disk_wait", 2}, {"syncq_wait", 2},
-	    {"asyncq_wait", 2}, {NULL}},
+	[IOS_L_HISTO] = {{"total_wait", 2}, {"disk_wait", 2},
+	    {"poll_wait", 2, B_TRUE}, {"syncq_wait", 2}, {"asyncq_wait", 2},
+	    {NULL}},
 	[IOS_RQ_HISTO] = {{"sync_read", 2}, {"sync_write", 2},
 	    {"async_read", 2}, {"async_write", 2}, {"scrub", 2},
 	    {"trim", 2}, {"rebuild", 2}, {NULL}},
@@ -4786,9 +4790,9 @@ static const name_and_columns_t iostat_bottom_labels[][IOSTAT_MAX_LABELS] =
 	[IOS_QUEUES] = {{"pend"}, {"activ"}, {"pend"}, {"activ"}, {"pend"},
 	    {"activ"}, {"pend"}, {"activ"}, {"pend"}, {"activ"},
 	    {"pend"}, {"activ"}, {"pend"}, {"activ"}, {NULL}},
-	[IOS_L_HISTO] = {{"read"}, {"write"}, {"read"}, {"write"}, {"read"},
-	    {"write"}, {"read"}, {"write"}, {"scrub"}, {"trim"}, {"rebuild"},
-	    {NULL}},
+	[IOS_L_HISTO] = {{"read"}, {"write"}, {"read"}, {"write"},
+	    {"read", 0, B_TRUE}, {"write", 0, B_TRUE}, {"read"}, {"write"},
+	    {"read"}, {"write"}, {"scrub"}, {"trim"}, {"rebuild"}, {NULL}},
 	[IOS_RQ_HISTO] = {{"ind"}, {"agg"}, {"ind"}, {"agg"}, {"ind"}, {"agg"},
 	    {"ind"}, {"agg"}, {"ind"}, {"agg"}, {"ind"}, {"agg"},
 	    {"ind"}, {"agg"}, {NULL}},
@@ -4800,37 +4804,41 @@ static const char *histo_to_title[] = {
 };
 
 /*
- * Return the number of labels in a null-terminated name_and_columns_t
- * array.
- *
+ * The poll latency histograms are only reported by newer modules.  If any
+ * pool lacks them, get_stat_flags_cb() clears this and their columns are
+ * left out rather than giving up on latency histograms altogether.
  */
-static unsigned int
-label_array_len(const name_and_columns_t *labels)
-{
-	int i = 0;
+static boolean_t iostat_poll_histos = B_TRUE;
 
-	while (labels[i].name)
-		i++;
+static boolean_t
+iostat_poll_histo_name(const char *name)
+{
+	return (strcmp(name, ZPOOL_CONFIG_VDEV_POLL_R_LAT_HISTO) == 0 ||
+	    strcmp(name, ZPOOL_CONFIG_VDEV_POLL_W_LAT_HISTO) == 0);
+}
 
-	return (i);
+static boolean_t
+label_shown(const name_and_columns_t *label)
+{
+	return (!label->poll || iostat_poll_histos);
 }
 
 /*
- * Return the number of strings in a null-terminated string array.
- * For example:
+ * Return the number of labels shown from a null-terminated
+ * name_and_columns_t array.
  *
- *     const char foo[] = {"bar", "baz", NULL}
- *
- * returns 2
  */
-static uint64_t
-str_array_len(const char *array[])
+static unsigned int
+label_array_len(const name_and_columns_t *labels)
 {
-	uint64_t i = 0;
-	while (array[i])
-		i++;
+	int i, len = 0;
+
+	for (i = 0; labels[i].name; i++) {
+		if (label_shown(&labels[i]))
+			len++;
+	}
 
-	return (i);
+	return (len);
 }
 
 
@@ -4885,8 +4893,12 @@ print_iostat_labels(iostat_cbdata_t *cb, unsigned int force_column_width,
 		if (!force_column_width)
 			column_width = default_column_width(cb, idx);
 		/* Print our top labels centered over "read  write" label. */
-		for (i = 0; i < label_array_len(labels[idx]); i++) {
+		for (i = 0; labels[idx][i].name; i++) {
 			const char *name = labels[idx][i].name;
+
+			if (!label_shown(&labels[idx][i]))
+				continue;
+
 			/*
 			 * We treat labels[][].columns == 0 as shorthand
 			 * for one column.  It makes writing out the label
@@ -5362,15 +5374,18 @@ print_iostat_histos(iostat_cbdata_t *cb, nvlist_t *oldnv,
 	unsigned int entire_width;
 	enum iostat_type type;
 	struct stat_array *nva;
-	const char **names;
-	unsigned int names_len;
+	const char *names[ARRAY_SIZE(vsx_type_to_nvlist[0])];
+	unsigned int names_len = 0;
 
 	/* What type of histo are we? */
 	type = IOS_HISTO_IDX(cb->cb_flags);
 
-	/* Get NULL-terminated array of nvlist names for our histo */
-	names = vsx_type_to_nvlist[type];
-	names_len = str_array_len(names); /* num of names */
+	/* Get the nvlist names for our histo, less any we don't have */
+	for (int i = 0; vsx_type_to_nvlist[type][i]; i++) {
+		if (iostat_poll_histos ||
+		    !iostat_poll_histo_name(vsx_type_to_nvlist[type][i]))
+			names[names_len++] = vsx_type_to_nvlist[type][i];
+	}
 
 	nva = calc_and_alloc_stats_ex(names, names_len, oldnv, newnv);
 
@@ -6014,6 +6029,12 @@ get_stat_flags_cb(zpool_handle_t *zhp, void *data)
 		flags |= (1ULL << j);
 		for (i = 0; vsx_type_to_nvlist[j][i]; i++) {
 			if (!nvlist_exists(nvx, vsx_type_to_nvlist[j][i])) {
+				/* optional, leave the column out */
+				if (iostat_poll_histo_name(
+				    vsx_type_to_nvlist[j][i])) {
+					iostat_poll_histos = B_FALSE;
+					continue;
+				}
 				/* flag isn't supported */
 				flags = flags & ~(1ULL  << j);
 				break;
@@ -384,18 +384,27 @@ print_vdev_latency_stats(nvlist_t *nvroot, const char *pool_name,
 	nvlist_t *nv_ex;
 	char *vdev_desc = NULL;
 
-	/* short_names become part of the metric name and are influxdb-ready */
+	/*
+	 * short_names become part of the metric name and are influxdb-ready.
+	 * Optional histograms are skipped when the module doesn't provide
+	 * them.
+	 */
 	struct lat_lookup {
 	    const char *name;
 	    const char *short_name;
 	    uint64_t sum;
 	    uint64_t *array;
+	    boolean_t optional;
 	};
 	struct lat_lookup lat_type[] = {
 	    {ZPOOL_CONFIG_VDEV_TOT_R_LAT_HISTO,   "total_read", 0},
 	    {ZPOOL_CONFIG_VDEV_TOT_W_LAT_HISTO,   "total_write", 0},
 	    {ZPOOL_CONFIG_VDEV_DISK_R_LAT_HISTO,  "disk_read", 0},
 	    {ZPOOL_CONFIG_VDEV_DISK_W_LAT_HISTO,  "disk_write", 0},
+#ifdef ZPOOL_CONFIG_VDEV_POLL_R_LAT_HISTO
+	    {ZPOOL_CONFIG_VDEV_POLL_R_LAT_HISTO,  "poll_read", 0, NULL, B_TRUE},
+	    {ZPOOL_CONFIG_VDEV_POLL_W_LAT_HISTO,  "poll_write", 0, NULL, B_TRUE},
+#endif
 	    {ZPOOL_CONFIG_VDEV_SYNC_R_LAT_HISTO,  "sync_read", 0},
 	    {ZPOOL_CONFIG_VDEV_SYNC_W_LAT_HISTO,  "sync_write", 0},
 	    {ZPOOL_CONFIG_VDEV_ASYNC_R_LAT_HISTO, "async_read", 0},
@@ -418,6 +427,10 @@ print_vdev_latency_stats(nvlist_t *nvroot, const char *pool_name,
 	for (int i = 0; lat_type[i].name; i++) {
 		if (nvlist_lookup_uint64_array(nv_ex,
 		    lat_type[i].name, &lat_type[i].array, &c) != 0) {
+			if (lat_type[i].optional) {
+				lat_type[i].array = NULL;
+				continue;
+			}
 			fprintf(stderr, "error: can't get %s\n",
 			    lat_type[i].name);
 			return (3);
@@ -430,7 +443,10 @@ print_vdev_latency_stats(nvlist_t *nvroot, const char *pool_name,
 		if (bucket < MIN_LAT_INDEX) {
 			/* don't print, but collect the sum */
 			for (int i = 0; lat_type[i].name; i++) {
-				lat_type[i].sum += lat_type[i].array[bucket];
+				if (lat_type[i].array != NULL) {
+					lat_type[i].sum +=
+					    lat_type[i].array[bucket];
+				}
 			}
 			continue;
 		}
@@ -444,16 +460,19 @@ print_vdev_latency_stats(nvlist_t *nvroot, const char *pool_name,
 			    POOL_LATENCY_MEASUREMENT, tags, pool_name,
 			    vdev_desc);
 		}
+		boolean_t first = B_TRUE;
 		for (int i = 0; lat_type[i].name; i++) {
+			if (lat_type[i].array == NULL)
+				continue;
 			if (bucket <= MIN_LAT_INDEX || sum_histogram_buckets) {
 				lat_type[i].sum += lat_type[i].array[bucket];
 			} else {
 				lat_type[i].sum = lat_type[i].array[bucket];
 			}
-			print_kv(lat_type[i].short_name, lat_type[i].sum);
-			if (lat_type[i + 1].name != NULL) {
+			if (!first)
 				printf(",");
-			}
+			first = B_FALSE;
+			print_kv(lat_type[i].short_name, lat_type[i].sum);
 		}
 		printf(" %llu\n", (u_longlong_t)timestamp);
 	}
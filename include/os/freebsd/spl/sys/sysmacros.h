@@ -82,6 +82,9 @@ extern "C" {
 #define	kpreempt_enable() critical_exit()
 #define	CPU_SEQID curcpu
 #define	CPU_SEQID_UNSTABLE curcpu
+#define	max_nnodes 1
+#define	CPU_NODEID 0
+#define	node_has_cpus(n) ((n) == 0)
 #define	is_system_labeled()		0
 /*
  * Convert a single byte to/from binary-coded decimal (BCD).
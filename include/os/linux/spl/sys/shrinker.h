@@ -43,6 +43,10 @@
  * progress.  Note that a return value of SHRINK_EMPTY is currently not
  * supported.
  *
+ * spl_register_numa_shrinker registers a shrinker which the kernel calls
+ * separately for each NUMA node under memory pressure, with the node in
+ * sc->nid.  Its countfunc must then only count the objects on that node.
+ *
  * Example:
  *
  * static unsigned long
@@ -76,6 +80,8 @@ typedef unsigned long (*spl_shrinker_cb)
 
 struct shrinker *spl_register_shrinker(const char *name,
     spl_shrinker_cb countfunc, spl_shrinker_cb scanfunc, int seek_cost);
+struct shrinker *spl_register_numa_shrinker(const char *name,
+    spl_shrinker_cb countfunc, spl_shrinker_cb scanfunc, int seek_cost);
 void spl_unregister_shrinker(struct shrinker *);
 
 #ifndef SHRINK_STOP
@@ -137,6 +137,8 @@ typedef struct taskq {
 	/* list node for the cpu hotplug callback */
 	struct hlist_node	tq_hp_cb_node;
 	boolean_t		tq_hp_support;
+	int			tq_node;	/* NUMA node, or NUMA_NO_NODE */
+	unsigned int		tq_node_next;	/* next CPU of tq_node */
 	unsigned long		lastspawnstop;	/* when to purge dynamic */
 	taskq_sums_t		tq_sums;
 	kstat_t			*tq_ksp;
@@ -192,6 +194,8 @@ extern void taskq_dispatch_ent(taskq_t *, task_func_t, void *, uint_t,
 extern int taskq_empty_ent(taskq_ent_t *);
 extern void taskq_init_ent(taskq_ent_t *);
 extern taskq_t *taskq_create(const char *, int, pri_t, int, int, uint_t);
+extern taskq_t *taskq_create_node(const char *, int, pri_t, int, int, uint_t,
+    int);
 extern taskq_t *taskq_create_synced(const char *, int, pri_t, int, int, uint_t,
     kthread_t ***);
 extern void taskq_destroy(taskq_t *);
@@ -341,6 +341,9 @@ uint64_t arc_boot_target_bytes(void);
 void arc_set_limits(uint64_t);
 void arc_init(void);
 void arc_fini(void);
+void arc_warm_start(spa_t *spa);
+void arc_warm_save(spa_t *spa);
+void arc_warm_fini(spa_t *spa);
 
 /*
  * Level 2 ARC
@@ -205,6 +205,8 @@ typedef struct l1arc_buf_hdr {
 	uint32_t		b_mfu_hits;
 	uint32_t		b_mfu_ghost_hits;
 	uint8_t			b_byteswap;
+	uint8_t			b_node;		/* NUMA node, see arc_cur_node() */
+	uint8_t			b_cost;		/* see arc_hdr_set_cost() */
 	arc_buf_t		*b_buf;
 
 	/* self protecting */
@@ -323,6 +325,24 @@ typedef struct l2arc_log_ent_phys {
 
 #define	L2ARC_LOG_BLK_MAX_ENTRIES	(1022)
 
+/*
+ * A hot primary ARC block remembered for the next import of the pool.
+ * The list is stored in a MOS object referenced by DMU_POOL_ARC_WARM,
+ * sorted by DVA.  Blocks are identified by their bookmark so that the
+ * warm-up reads go through the live block pointers and are checksum
+ * verified; the DVA is only used to issue them in LBA order.  An entry
+ * with a zero birth txg is unused.
+ */
+typedef struct arc_warm_phys {
+	uint64_t		awp_objset;
+	uint64_t		awp_object;
+	int64_t			awp_level;
+	uint64_t		awp_blkid;
+	uint64_t		awp_vdev;	/* DVA[0] vdev */
+	uint64_t		awp_offset;	/* DVA[0] offset */
+	uint64_t		awp_birth;	/* physical birth txg */
+} arc_warm_phys_t;
+
 /*
  * A log block of up to 1022 ARC buffer log entries, chained into the
  * persistent L2ARC metadata linked list. Byte order of magic determines
@@ -374,6 +394,17 @@ typedef struct l2arc_lb_ptr_buf {
 	list_node_t		node;
 } l2arc_lb_ptr_buf_t;
 
+/*
+ * A hot L2-only buffer read back from the region about to be evicted,
+ * waiting to be written again at the write hand.  See l2arc_retain_hits.
+ */
+typedef struct l2arc_retain_buf {
+	l2arc_log_ent_phys_t	lr_le;		/* identity and old address */
+	abd_t			*lr_abd;	/* data as stored on device */
+	int			lr_error;	/* read error */
+	list_node_t		lr_node;
+} l2arc_retain_buf_t;
+
 /* Macros for setting fields in le_prop and lbp_prop */
 #define	L2BLK_GET_LSIZE(field)	\
 	BF64_GET_SB((field), 0, SPA_LSIZEBITS, SPA_MINBLOCKSHIFT, 1)
@@ -446,6 +477,8 @@ typedef struct l2arc_dev {
 	uint64_t		l2ad_evict;	 /* evicted offset in bytes */
 	/* List of pointers to log blocks present in the L2ARC device */
 	list_t			l2ad_lbptr_list;
+	/* Hot buffers l2arc_evict() handed to l2arc_write_buffers() */
+	list_t			l2ad_retain_list;
 	/*
 	 * Aligned size of all log blocks as accounted by vdev_space_update().
 	 */
@@ -462,6 +495,19 @@ typedef struct l2arc_dev {
 	uint64_t		l2ad_dwpd_start;	/* 24h period start */
 	uint64_t		l2ad_dwpd_accumulated;	/* Accumulated */
 	uint64_t		l2ad_dwpd_bump;		/* Reset trigger */
+	/*
+	 * Adaptive write throttle, see l2arc_write_ctl_update()
+	 */
+	uint64_t		l2ad_wctl_rate;		/* bytes/s, 0 = unset */
+	int			l2ad_wctl_dir;		/* last step, +1/-1 */
+	hrtime_t		l2ad_wctl_interval;	/* feed interval, ns */
+	hrtime_t		l2ad_wctl_lat;		/* avg write latency, ns */
+	hrtime_t		l2ad_wctl_epoch;	/* sample period start */
+	wmsum_t			l2ad_wctl_hits;		/* hit bytes, ever */
+	uint64_t		l2ad_wctl_hits_start;	/* hits at period start */
+	uint64_t		l2ad_wctl_written;	/* bytes written in period */
+	uint64_t		l2ad_wctl_hit_rate;	/* last hit bytes/s */
+	uint64_t		l2ad_wctl_write_rate;	/* last write bytes/s */
 	/*
 	 * Per-device feed thread for parallel L2ARC writes
 	 */
@@ -519,6 +565,8 @@ typedef struct l2arc_buf_hdr {
 typedef struct l2arc_write_callback {
 	l2arc_dev_t	*l2wcb_dev;		/* device info */
 	arc_buf_hdr_t	*l2wcb_head;		/* head of write buflist */
+	hrtime_t	l2wcb_start;		/* time writes were started */
+	uint64_t	l2wcb_asize;		/* bytes written */
 	/* in-flight list of log blocks */
 	list_t		l2wcb_abd_list;
 } l2arc_write_callback_t;
@@ -625,6 +673,17 @@ typedef struct arc_stats {
 	 * buffers to reach its target amount.
 	 */
 	kstat_named_t arcstat_evict_not_enough;
+	/*
+	 * Number of buffers skipped because they would be expensive to read
+	 * back and have not yet outlived their zfs_arc_evict_cost_ms bonus.
+	 */
+	kstat_named_t arcstat_evict_cost_skip;
+	/*
+	 * Bytes evicted from the NUMA node the shrinker reported memory
+	 * pressure on, before evicting from all nodes.  See
+	 * zfs_arc_evict_numa.
+	 */
+	kstat_named_t arcstat_evict_numa_local;
 	kstat_named_t arcstat_evict_l2_cached;
 	kstat_named_t arcstat_evict_l2_eligible;
 	kstat_named_t arcstat_evict_l2_eligible_mfu;
@@ -636,6 +695,13 @@ typedef struct arc_stats {
 	kstat_named_t arcstat_hash_collisions;
 	kstat_named_t arcstat_hash_chains;
 	kstat_named_t arcstat_hash_chain_max;
+	/*
+	 * Number of hash table lookups which were resolved without taking
+	 * the hash lock (the bucket was empty), and the number of lookups
+	 * which had to take the hash lock to walk a chain.
+	 */
+	kstat_named_t arcstat_hash_lookup_lockless;
+	kstat_named_t arcstat_hash_lookup_locked;
 	kstat_named_t arcstat_meta;
 	kstat_named_t arcstat_pd;
 	kstat_named_t arcstat_pm;
@@ -859,6 +925,26 @@ typedef struct arc_stats {
 	kstat_named_t arcstat_l2_evict_lock_retry;
 	kstat_named_t arcstat_l2_evict_reading;
 	kstat_named_t arcstat_l2_evict_l1cached;
+	/*
+	 * Bytes of L2ARC buffers dropped ahead of the write hand, and the
+	 * hot L2-only buffers written again at the write hand instead of
+	 * being dropped.  See l2arc_retain_hits.
+	 */
+	kstat_named_t arcstat_l2_evict_bytes;
+	kstat_named_t arcstat_l2_retain_bytes;
+	kstat_named_t arcstat_l2_retain_bufs;
+	/*
+	 * State of the adaptive L2ARC write throttle, summed over all cache
+	 * devices: the write rate it allows (bytes/s), the L2ARC read hit
+	 * rate it last measured (bytes/s) and the average latency of L2ARC
+	 * writes (ns).  l2_write_ctl_busy counts how often the write rate
+	 * was cut because the device was slow to complete writes.
+	 * See l2arc_write_adaptive.
+	 */
+	kstat_named_t arcstat_l2_write_ctl_rate;
+	kstat_named_t arcstat_l2_write_ctl_hit_rate;
+	kstat_named_t arcstat_l2_write_ctl_latency;
+	kstat_named_t arcstat_l2_write_ctl_busy;
 	kstat_named_t arcstat_l2_free_on_write;
 	kstat_named_t arcstat_l2_abort_lowmem;
 	kstat_named_t arcstat_l2_cksum_bad;
@@ -964,6 +1050,13 @@ typedef struct arc_stats {
 	kstat_named_t arcstat_sys_free;
 	kstat_named_t arcstat_raw_size;
 	kstat_named_t arcstat_cached_only_in_progress;
+	/*
+	 * Number of data blocks, not found in the ARC or its ghost lists,
+	 * which the admission filter allowed to be cached, and the number
+	 * which it read into the uncached state instead.
+	 */
+	kstat_named_t arcstat_admission_accepted;
+	kstat_named_t arcstat_admission_rejected;
 	kstat_named_t arcstat_abd_chunk_waste_size;
 } arc_stats_t;
 
@@ -993,6 +1086,8 @@ typedef struct arc_sums {
 	wmsum_t arcstat_access_skip;
 	wmsum_t arcstat_evict_skip;
 	wmsum_t arcstat_evict_not_enough;
+	wmsum_t arcstat_evict_cost_skip;
+	wmsum_t arcstat_evict_numa_local;
 	wmsum_t arcstat_evict_l2_cached;
 	wmsum_t arcstat_evict_l2_eligible;
 	wmsum_t arcstat_evict_l2_eligible_mfu;
@@ -1002,6 +1097,8 @@ typedef struct arc_sums {
 	wmsum_t arcstat_hash_elements;
 	wmsum_t arcstat_hash_collisions;
 	wmsum_t arcstat_hash_chains;
+	wmsum_t arcstat_hash_lookup_lockless;
+	wmsum_t arcstat_hash_lookup_locked;
 	aggsum_t arcstat_size;
 	wmsum_t arcstat_compressed_size;
 	wmsum_t arcstat_uncompressed_size;
@@ -1030,6 +1127,13 @@ typedef struct arc_sums {
 	wmsum_t arcstat_l2_evict_lock_retry;
 	wmsum_t arcstat_l2_evict_reading;
 	wmsum_t arcstat_l2_evict_l1cached;
+	wmsum_t arcstat_l2_evict_bytes;
+	wmsum_t arcstat_l2_retain_bytes;
+	wmsum_t arcstat_l2_retain_bufs;
+	wmsum_t arcstat_l2_write_ctl_rate;
+	wmsum_t arcstat_l2_write_ctl_hit_rate;
+	wmsum_t arcstat_l2_write_ctl_latency;
+	wmsum_t arcstat_l2_write_ctl_busy;
 	wmsum_t arcstat_l2_free_on_write;
 	wmsum_t arcstat_l2_abort_lowmem;
 	wmsum_t arcstat_l2_cksum_bad;
@@ -1065,6 +1169,8 @@ typedef struct arc_sums {
 	wmsum_t arcstat_demand_iohit_prescient_prefetch;
 	wmsum_t arcstat_raw_size;
 	wmsum_t arcstat_cached_only_in_progress;
+	wmsum_t arcstat_admission_accepted;
+	wmsum_t arcstat_admission_rejected;
 	wmsum_t arcstat_abd_chunk_waste_size;
 } arc_sums_t;
 
@@ -1124,6 +1230,9 @@ extern void arc_wait_for_eviction(uint64_t, boolean_t, boolean_t);
 
 extern void arc_lowmem_init(void);
 extern void arc_lowmem_fini(void);
+extern uint_t arc_numa_nodes;
+extern uint64_t arc_numa_node_share(int node, uint64_t pages);
+extern void arc_numa_evict_node(int node);
 extern int arc_memory_throttle(spa_t *spa, uint64_t reserve, uint64_t txg);
 extern uint64_t arc_free_memory(void);
 extern int64_t arc_available_memory(void);
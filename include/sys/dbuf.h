@@ -332,13 +332,35 @@ typedef struct dmu_buf_impl {
 #define	DBUF_HASH_MUTEX(h, idx) \
 	(&(h)->hash_mutexes[(idx) & ((h)->hash_mutex_mask)])
 
+/*
+ * The hash table grows incrementally.  Once it is too full, a table twice
+ * the size is allocated in hash_table_new and the buckets of the old table
+ * are moved over a few at a time by the dbuf_hash_grow zthr; the buckets
+ * below hash_table_split have been moved.  There are never more mutexes
+ * than buckets, so an old bucket is protected by the same mutex as the two
+ * new buckets it is split into, and holding DBUF_HASH_MUTEX() for a hash
+ * value is enough to use dbuf_hash_chain().
+ */
 typedef struct dbuf_hash_table {
 	uint64_t hash_table_mask;
 	uint64_t hash_mutex_mask;
 	dmu_buf_impl_t **hash_table;
 	kmutex_t *hash_mutexes;
+	dmu_buf_impl_t **hash_table_new;
+	uint64_t hash_table_split;
 } dbuf_hash_table_t;
 
+static inline dmu_buf_impl_t **
+dbuf_hash_chain(dbuf_hash_table_t *h, uint64_t hv)
+{
+	uint64_t idx = hv & h->hash_table_mask;
+
+	ASSERT(MUTEX_HELD(DBUF_HASH_MUTEX(h, hv)));
+	if (h->hash_table_new != NULL && idx < h->hash_table_split)
+		return (&h->hash_table_new[hv & (2 * h->hash_table_mask + 1)]);
+	return (&h->hash_table[idx]);
+}
+
 typedef void (*dbuf_prefetch_fn)(void *, uint64_t, uint64_t, boolean_t);
 
 extern kmem_cache_t *dbuf_dirty_kmem_cache;
@@ -352,6 +374,10 @@ int dbuf_spill_set_blksz(dmu_buf_t *db, uint64_t blksz, dmu_tx_t *tx);
 void dbuf_rm_spill(struct dnode *dn, dmu_tx_t *tx);
 
 dmu_buf_impl_t *dbuf_hold(struct dnode *dn, uint64_t blkid, const void *tag);
+dmu_buf_impl_t *dbuf_hold_cached(struct dnode *dn, uint64_t offset,
+    const void *tag);
+int dbuf_hold_array(struct dnode *dn, uint64_t blkid, uint64_t nblks,
+    const void *tag, dmu_buf_t **dbp);
 dmu_buf_impl_t *dbuf_hold_level(struct dnode *dn, int level, uint64_t blkid,
     const void *tag);
 int dbuf_hold_impl(struct dnode *dn, uint8_t level, uint64_t blkid,
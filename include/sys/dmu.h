@@ -57,6 +57,7 @@
 extern "C" {
 #endif
 
+struct abd;
 struct page;
 struct vnode;
 struct spa;
@@ -417,6 +418,7 @@ typedef struct dmu_buf {
 #define	DMU_POOL_TXG_LOG_TIME_MINUTES	"com.klarasystems:txg_log_time:minutes"
 #define	DMU_POOL_TXG_LOG_TIME_DAYS	"com.klarasystems:txg_log_time:days"
 #define	DMU_POOL_TXG_LOG_TIME_MONTHS	"com.klarasystems:txg_log_time:months"
+#define	DMU_POOL_ARC_WARM		"org.openzfs:arc_warm"
 
 /*
  * Allocate an object from this objset.  The range of object numbers
@@ -574,6 +576,7 @@ typedef enum dmu_flags {
 	DMU_PARTIAL_MORE	= 1 << 8, /* Following partial access. */
 	DMU_KEEP_CACHING	= 1 << 9, /* Don't affect caching. */
 	DMU_IS_PREFETCH		= 1 << 10, /* This read is a prefetch. */
+	DMU_DIRECTIO_RMW	= 1 << 11, /* Direct I/O read-modify-write. */
 } dmu_flags_t;
 
 /*
@@ -930,6 +933,10 @@ int dmu_write_by_dnode(dnode_t *dn, uint64_t offset, uint64_t size,
     const void *buf, dmu_tx_t *tx, dmu_flags_t flags);
 void dmu_prealloc(objset_t *os, uint64_t object, uint64_t offset, uint64_t size,
     dmu_tx_t *tx);
+int dmu_read_abd_dbuf_nowait(dmu_buf_t *zdb, uint64_t offset, uint64_t size,
+    struct abd *data, dmu_flags_t flags, struct zio *pio);
+int dmu_read_abd_dbuf_cached(dmu_buf_t *zdb, uint64_t offset, uint64_t size,
+    struct abd *data, dmu_flags_t flags);
 #ifdef _KERNEL
 int dmu_read_uio(objset_t *os, uint64_t object, zfs_uio_t *uio, uint64_t size,
     dmu_flags_t flags);
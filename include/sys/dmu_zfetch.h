@@ -38,12 +38,34 @@ extern "C" {
 #endif
 
 struct dnode;				/* so we can reference dnode */
+struct zstream;
+
+/*
+ * Accesses that are not hits for any stream, checked for a constant stride
+ * between their starts, either forward with holes or backward.  The
+ * predicted accesses are recorded in zp_pf_* by dmu_zfetch_prepare() and
+ * prefetched by dmu_zfetch_run() through zp_stream.
+ */
+typedef struct zpattern {
+	uint64_t	zp_blkid;	/* start of the last access */
+	int64_t		zp_stride;	/* blkid change from the previous one */
+	uint64_t	zp_next;	/* first access start not prefetched */
+	unsigned int	zp_dist;	/* data prefetch distance in bytes */
+	unsigned int	zp_hits;	/* accesses following zp_stride */
+	struct zstream	*zp_stream;	/* references for pending blocks */
+	uint64_t	zp_pf_blkid;	/* first access to prefetch for */
+	int64_t		zp_pf_stride;	/* blkid change between them */
+	uint64_t	zp_pf_nblks;	/* blocks per access */
+	unsigned int	zp_pf_count;	/* accesses to prefetch for */
+	boolean_t	zp_pf_data;	/* data, or only indirect blocks */
+} zpattern_t;
 
 typedef struct zfetch {
 	kmutex_t	zf_lock;	/* protects zfetch structure */
 	list_t		zf_stream;	/* list of zstream_t's */
 	struct dnode	*zf_dnode;	/* dnode that owns this zfetch */
 	int		zf_numstreams;	/* number of zstream_t's */
+	zpattern_t	zf_pattern;	/* strided or reverse accesses */
 } zfetch_t;
 
 typedef struct zsrange {
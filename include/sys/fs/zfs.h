@@ -486,6 +486,7 @@ typedef enum {
 	VDEV_PROP_FGROUP,
 	VDEV_PROP_ALLOC_BIAS,
 	VDEV_PROP_ROTATIONAL,
+	VDEV_PROP_POLL,
 	VDEV_NUM_PROPS
 } vdev_prop_t;
 
@@ -906,6 +907,8 @@ typedef struct zpool_load_policy {
 #define	ZPOOL_CONFIG_VDEV_TOT_W_LAT_HISTO	"vdev_tot_w_lat_histo"
 #define	ZPOOL_CONFIG_VDEV_DISK_R_LAT_HISTO	"vdev_disk_r_lat_histo"
 #define	ZPOOL_CONFIG_VDEV_DISK_W_LAT_HISTO	"vdev_disk_w_lat_histo"
+#define	ZPOOL_CONFIG_VDEV_POLL_R_LAT_HISTO	"vdev_poll_r_lat_histo"
+#define	ZPOOL_CONFIG_VDEV_POLL_W_LAT_HISTO	"vdev_poll_w_lat_histo"
 #define	ZPOOL_CONFIG_VDEV_SYNC_R_LAT_HISTO	"vdev_sync_r_lat_histo"
 #define	ZPOOL_CONFIG_VDEV_SYNC_W_LAT_HISTO	"vdev_sync_w_lat_histo"
 #define	ZPOOL_CONFIG_VDEV_ASYNC_R_LAT_HISTO	"vdev_async_r_lat_histo"
@@ -1491,6 +1494,9 @@ typedef struct vdev_stat_ex {
 	/* Amount of time to read/write the disk (ns) */
 	uint64_t vsx_disk_histo[ZIO_TYPES][VDEV_L_HISTO_BUCKETS];
 
+	/* Subset of vsx_disk_histo completed by polling (ns) */
+	uint64_t vsx_poll_histo[ZIO_TYPES][VDEV_L_HISTO_BUCKETS];
+
 	/* "lookup the bucket for a value" histogram macros */
 #define	HISTO(val, buckets) (val != 0 ? MIN(highbit64(val) - 1, \
 	    buckets - 1) : 0)
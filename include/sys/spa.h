@@ -947,6 +947,8 @@ typedef struct spa_stats {
 	spa_history_kstat_t	guid;		/* pool guid */
 	spa_history_kstat_t	iostats;
 	spa_history_kstat_t	log_spacemaps;
+	spa_history_kstat_t	taskq_nodes;
+	spa_history_kstat_t	vdev_queue;
 } spa_stats_t;
 
 typedef enum txg_state {
@@ -993,6 +995,10 @@ typedef struct spa_iostats {
 	kstat_named_t	direct_read_bytes;
 	kstat_named_t	direct_write_count;
 	kstat_named_t	direct_write_bytes;
+	kstat_named_t	direct_rmw_count;
+	kstat_named_t	arc_warm_blocks;
+	kstat_named_t	arc_warm_issued;
+	kstat_named_t	arc_warm_skipped;
 } spa_iostats_t;
 
 extern void spa_stats_init(spa_t *spa);
@@ -1006,6 +1012,7 @@ extern txg_stat_t *spa_txg_history_init_io(spa_t *, uint64_t,
     struct dsl_pool *);
 extern void spa_txg_history_fini_io(spa_t *, txg_stat_t *);
 extern void spa_tx_assign_add_nsecs(spa_t *spa, uint64_t nsecs);
+extern void spa_taskq_node_add(spa_t *spa, uint_t node, boolean_t remote);
 extern int spa_mmp_history_set_skip(spa_t *spa, uint64_t mmp_kstat_id);
 extern int spa_mmp_history_set(spa_t *spa, uint64_t mmp_kstat_id, int io_error,
     hrtime_t duration);
@@ -1020,6 +1027,8 @@ extern void spa_iostats_read_add(spa_t *spa, uint64_t size, uint64_t iops,
     dmu_flags_t flags);
 extern void spa_iostats_write_add(spa_t *spa, uint64_t size, uint64_t iops,
     dmu_flags_t flags);
+extern void spa_iostats_arc_warm_add(spa_t *spa, uint64_t blocks,
+    uint64_t issued, uint64_t skipped);
 extern void spa_import_progress_add(spa_t *spa);
 extern void spa_import_progress_remove(uint64_t spa_guid);
 extern int spa_import_progress_set_mmp_check(uint64_t pool_guid,
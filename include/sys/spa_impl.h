@@ -192,8 +192,12 @@ typedef enum spa_proc_state {
 	SPA_PROC_GONE		/* spa_thread() is exiting, spa_proc = &p0 */
 } spa_proc_state_t;
 
+/* Most NUMA nodes zio taskqs are split across, see zio_taskq_numa */
+#define	SPA_TASKQ_NODES_MAX	64
+
 typedef struct spa_taskqs {
 	uint_t stqs_count;
+	uint_t stqs_nodes;	/* NUMA nodes the taskqs are split across */
 	taskq_t **stqs_taskq;
 } spa_taskqs_t;
 
@@ -305,6 +309,11 @@ struct spa {
 	spa_aux_vdev_t	spa_l2cache;		/* L2ARC cache devices */
 	boolean_t	spa_aux_sync_uber;	/* need to sync aux uber */
 	l2arc_info_t	spa_l2arc_info;		/* L2ARC state and stats */
+	kmutex_t	spa_arc_warm_lock;	/* protects spa_arc_warm */
+	struct arc_warm_phys *spa_arc_warm;	/* hot ARC blocks to save */
+	uint64_t	spa_arc_warm_size;	/* entries in spa_arc_warm */
+	boolean_t	spa_arc_warm_pending;	/* saved list not yet read */
+	zthr_t		*spa_arc_warm_zthr;	/* ARC warm-up prefetcher */
 	nvlist_t	*spa_label_features;	/* Features for reading MOS */
 	uint64_t	spa_config_object;	/* MOS object for pool config */
 	uint64_t	spa_config_generation;	/* config generation number */
@@ -524,6 +533,10 @@ extern const char *zfs_deadman_failmode;
 extern uint_t spa_slop_shift;
 extern void spa_taskq_dispatch(spa_t *spa, zio_type_t t, zio_taskq_type_t q,
     task_func_t *func, zio_t *zio, boolean_t cutinline);
+extern void spa_numa_init(void);
+extern void spa_numa_fini(void);
+extern uint_t spa_taskq_nodes(void);
+extern int spa_taskq_node_id(uint_t index);
 extern void spa_load_spares(spa_t *spa);
 extern void spa_load_l2cache(spa_t *spa);
 extern sysevent_t *spa_event_create(spa_t *spa, vdev_t *vd, nvlist_t *hist_nvl,
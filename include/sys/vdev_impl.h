@@ -151,6 +151,15 @@ struct vdev_queue {
 	list_t		vq_active_list;	/* List of active I/Os. */
 	hrtime_t	vq_io_complete_ts; /* time last i/o completed */
 	hrtime_t	vq_io_delta_ts;
+
+	/* Sync read latency target state, see vdev_queue_lt_update(). */
+	uint32_t	vq_lt_limit[ZIO_PRIORITY_NUM_QUEUEABLE];
+	hrtime_t	vq_lt_wait[ZIO_PRIORITY_NUM_QUEUEABLE];
+	hrtime_t	vq_lt_service[ZIO_PRIORITY_NUM_QUEUEABLE];
+	uint32_t	vq_lt_reads;	/* sync reads in this window */
+	uint32_t	vq_lt_late;	/* of which missed the target */
+	uint32_t	vq_lt_busy;	/* classes active as they did */
+	hrtime_t	vq_lt_window_ts; /* start of this window */
 	zio_t		vq_io_search; /* used as local for stack reduction */
 	kmutex_t	vq_lock;
 };
@@ -467,6 +476,7 @@ struct vdev {
 	uint64_t	vdev_slow_io_n;
 	uint64_t	vdev_slow_io_t;
 	uint64_t	vdev_scheduler; /* control how I/Os are submitted */
+	boolean_t	vdev_poll;	/* poll for sync I/O completion */
 };
 
 #define	VDEV_PAD_SIZE		(8 << 10)
@@ -665,6 +675,11 @@ int param_set_max_auto_ashift(ZFS_MODULE_PARAM_ARGS);
  */
 extern uint_t zfs_vdev_direct_write_verify;
 
+/*
+ * Sync read latency target for the vdev queue
+ */
+extern uint_t zfs_vdev_sync_read_target_us;
+
 #ifdef	__cplusplus
 }
 #endif
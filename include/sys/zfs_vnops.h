@@ -30,9 +30,18 @@
 #include <sys/zfs_vnops_os.h>
 
 extern int zfs_bclone_enabled;
+extern uint64_t zfs_readdir_prefetch_bytes;
+
+/* Entries zfs_readdir() collects for zfs_readdir_prefetch() at a time */
+#define	ZFS_READDIR_PREFETCH_BATCH	64
+
+/* Completion callback of zfs_read_async(): arg, error, bytes read */
+typedef void zfs_read_done_t(void *, int, ssize_t);
 
 extern int zfs_fsync(znode_t *, int, cred_t *);
 extern int zfs_read(znode_t *, zfs_uio_t *, int, cred_t *);
+extern int zfs_read_async(znode_t *, zfs_uio_t *, int, cred_t *,
+    zfs_read_done_t *, void *);
 extern int zfs_write(znode_t *, zfs_uio_t *, int, cred_t *);
 extern int zfs_holey(znode_t *, ulong_t, loff_t *);
 extern int zfs_access(znode_t *, int, int, cred_t *);
@@ -46,6 +55,7 @@ extern int zfs_getsecattr(znode_t *, vsecattr_t *, int, cred_t *);
 extern int zfs_setsecattr(znode_t *, vsecattr_t *, int, cred_t *);
 
 extern int zfs_get_direct_alignment(znode_t *, uint64_t *);
+extern void zfs_readdir_prefetch(objset_t *, const uint64_t *, uint_t);
 
 extern int mappedread(znode_t *, int, zfs_uio_t *);
 extern int mappedread_sf(znode_t *, int, zfs_uio_t *);
@@ -245,6 +245,7 @@ typedef uint64_t zio_flag_t;
 #define	ZIO_FLAG_DELEGATED	(1ULL << 32)
 #define	ZIO_FLAG_PREALLOCATED	(1ULL << 33)
 #define	ZIO_FLAG_POSTREAD	(1ULL << 34)
+#define	ZIO_FLAG_POLLED		(1ULL << 35)
 
 #define	ZIO_ALLOCATOR_NONE	(-1)
 #define	ZIO_HAS_ALLOCATOR(zio)	((zio)->io_allocator != ZIO_ALLOCATOR_NONE)
@@ -499,6 +500,7 @@ struct zio {
 	blkptr_t	*io_bp_override;
 	blkptr_t	io_bp_copy;
 	list_t		io_parent_list;
+	zio_link_t	io_parent_link;	/* link to the first parent */
 	list_t		io_child_list;
 	zio_t		*io_logical;
 	zio_transform_t *io_transform_stack;
@@ -562,6 +564,14 @@ struct zio {
 	kmutex_t	io_lock;
 	kcondvar_t	io_cv;
 	int		io_allocator;
+	int		io_node;	/* NUMA node of the issuer */
+
+	/* Inline completion state, see zio_inline_complete() */
+	zio_t		*io_inline_root;
+	zio_t		*io_inline_list;
+	zio_t		*io_inline_next;
+	boolean_t	io_inline;
+	boolean_t	io_inline_queued;
 
 	/* FMA state */
 	zio_cksum_report_t *io_cksum_report;
@@ -646,6 +656,7 @@ extern int zio_wait(zio_t *zio);
 extern void zio_nowait(zio_t *zio);
 extern void zio_execute(void *zio);
 extern void zio_interrupt(void *zio);
+extern boolean_t zio_inline_complete(zio_t *zio);
 extern void zio_delay_init(zio_t *zio);
 extern void zio_delay_interrupt(zio_t *zio);
 extern void zio_deadman(zio_t *zio, const char *tag);
@@ -654,6 +665,7 @@ extern zio_t *zio_walk_parents(zio_t *cio, zio_link_t **);
 extern zio_t *zio_walk_children(zio_t *pio, zio_link_t **);
 extern zio_t *zio_unique_parent(zio_t *cio);
 extern void zio_add_child(zio_t *pio, zio_t *cio);
+extern void zio_add_child_first(zio_t *pio, zio_t *cio);
 
 extern void *zio_buf_alloc(size_t size);
 extern void zio_buf_free(void *buf, size_t size);
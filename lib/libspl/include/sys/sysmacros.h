@@ -120,6 +120,9 @@
 
 #define	CPU_SEQID	((uintptr_t)pthread_self() & (max_ncpus - 1))
 #define	CPU_SEQID_UNSTABLE	CPU_SEQID
+#define	max_nnodes	1
+#define	CPU_NODEID	0
+#define	node_has_cpus(n)	((n) == 0)
 
 /*
  * Find highest one bit set.
@@ -99,6 +99,8 @@ extern taskq_t	*taskq_create_synced(const char *, int, pri_t, int, int, uint_t,
     kthread_t ***);
 #define	taskq_create_proc(a, b, c, d, e, p, f) \
 	    (taskq_create(a, b, c, d, e, f))
+#define	taskq_create_node(a, b, c, d, e, f, n) \
+	    ((void) (n), taskq_create(a, b, c, d, e, f))
 #define	taskq_create_sysdc(a, b, d, e, p, dc, f) \
 	    ((void) sizeof (dc), taskq_create(a, b, maxclsyspri, d, e, f))
 extern taskqid_t taskq_dispatch(taskq_t *, task_func_t, void *, uint_t);
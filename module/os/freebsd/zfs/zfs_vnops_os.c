@@ -1698,6 +1698,8 @@ zfs_readdir(vnode_t *vp, zfs_uio_t *uio, cred_t *cr, int *eofp,
 	int		outcount;
 	int		error;
 	uint8_t		prefetch;
+	uint64_t	*pf_objs = NULL;
+	uint_t		pf_count = 0;
 	uint8_t		type;
 	int		ncooks;
 	cookie_t	*cooks = NULL;
@@ -1739,6 +1741,10 @@ zfs_readdir(vnode_t *vp, zfs_uio_t *uio, cred_t *cr, int *eofp,
 	offset = zfs_uio_offset(uio);
 	orig_resid = zfs_uio_resid(uio);
 	prefetch = zp->z_zn_prefetch;
+	if (prefetch && zfs_readdir_prefetch_bytes != 0) {
+		pf_objs = kmem_alloc(ZFS_READDIR_PREFETCH_BATCH *
+		    sizeof (uint64_t), KM_SLEEP);
+	}
 	zap = zap_attribute_long_alloc();
 
 	/*
@@ -1836,6 +1842,10 @@ zfs_readdir(vnode_t *vp, zfs_uio_t *uio, cred_t *cr, int *eofp,
 			 * uint8_t type = ZFS_DIRENT_TYPE(zap.za_first_integer);
 			 */
 			type = ZFS_DIRENT_TYPE(zap->za_first_integer);
+			if (pf_objs != NULL &&
+			    (type == DT_REG || type == DT_DIR)) {
+				pf_objs[pf_count++] = objnum;
+			}
 		}
 
 		reclen = DIRENT64_RECLEN(strlen(zap->za_name));
@@ -1872,6 +1882,10 @@ zfs_readdir(vnode_t *vp, zfs_uio_t *uio, cred_t *cr, int *eofp,
 
 		if (prefetch)
 			dmu_prefetch_dnode(os, objnum, ZIO_PRIORITY_SYNC_READ);
+		if (pf_count == ZFS_READDIR_PREFETCH_BATCH) {
+			zfs_readdir_prefetch(os, pf_objs, pf_count);
+			pf_count = 0;
+		}
 
 		/*
 		 * Move to the next entry, fill in the previous offset.
@@ -1911,6 +1925,11 @@ zfs_readdir(vnode_t *vp, zfs_uio_t *uio, cred_t *cr, int *eofp,
 	}
 
 update:
+	if (pf_objs != NULL) {
+		zfs_readdir_prefetch(os, pf_objs, pf_count);
+		kmem_free(pf_objs, ZFS_READDIR_PREFETCH_BATCH *
+		    sizeof (uint64_t));
+	}
 	zap_cursor_fini(&zc);
 	zap_attribute_free(zap);
 	if (zfs_uio_segflg(uio) != UIO_SYSSPACE || zfs_uio_iovcnt(uio) != 1)
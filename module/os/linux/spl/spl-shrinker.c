@@ -27,16 +27,16 @@
 #include <sys/kmem.h>
 #include <sys/shrinker.h>
 
-struct shrinker *
-spl_register_shrinker(const char *name, spl_shrinker_cb countfunc,
-    spl_shrinker_cb scanfunc, int seek_cost)
+static struct shrinker *
+spl_register_shrinker_impl(const char *name, spl_shrinker_cb countfunc,
+    spl_shrinker_cb scanfunc, int seek_cost, unsigned int flags)
 {
 	struct shrinker *shrinker;
 
 	/* allocate shrinker */
 #ifdef HAVE_SHRINKER_REGISTER
 	/* 6.7: kernel will allocate the shrinker for us */
-	shrinker = shrinker_alloc(0, name);
+	shrinker = shrinker_alloc(flags, name);
 #else
 	/* 4.4-6.6: we allocate the shrinker  */
 	shrinker = kmem_zalloc(sizeof (struct shrinker), KM_SLEEP);
@@ -51,6 +51,9 @@ spl_register_shrinker(const char *name, spl_shrinker_cb countfunc,
 
 	/* set params */
 	shrinker->seeks = seek_cost;
+#ifndef HAVE_SHRINKER_REGISTER
+	shrinker->flags = flags;
+#endif
 
 	/* register with kernel */
 #if defined(HAVE_SHRINKER_REGISTER)
@@ -63,8 +66,30 @@ spl_register_shrinker(const char *name, spl_shrinker_cb countfunc,
 
 	return (shrinker);
 }
+
+struct shrinker *
+spl_register_shrinker(const char *name, spl_shrinker_cb countfunc,
+    spl_shrinker_cb scanfunc, int seek_cost)
+{
+	return (spl_register_shrinker_impl(name, countfunc, scanfunc,
+	    seek_cost, 0));
+}
 EXPORT_SYMBOL(spl_register_shrinker);
 
+struct shrinker *
+spl_register_numa_shrinker(const char *name, spl_shrinker_cb countfunc,
+    spl_shrinker_cb scanfunc, int seek_cost)
+{
+#ifdef SHRINKER_NUMA_AWARE
+	return (spl_register_shrinker_impl(name, countfunc, scanfunc,
+	    seek_cost, SHRINKER_NUMA_AWARE));
+#else
+	return (spl_register_shrinker_impl(name, countfunc, scanfunc,
+	    seek_cost, 0));
+#endif
+}
+EXPORT_SYMBOL(spl_register_numa_shrinker);
+
 void
 spl_unregister_shrinker(struct shrinker *shrinker)
 {
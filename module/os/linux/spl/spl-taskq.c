@@ -36,6 +36,7 @@
 #include <sys/atomic.h>
 #include <sys/kstat.h>
 #include <linux/cpuhotplug.h>
+#include <linux/topology.h>
 #include <linux/mod_compat.h>
 
 /* Linux 6.2 renamed timer_delete_sync(); point it at its old name for those. */
@@ -1157,6 +1158,31 @@ error:
 	return (0);
 }
 
+/*
+ * Returns the next online CPU of the taskq's NUMA node to bind a new thread
+ * to, or nr_cpu_ids if the node has none.  Threads are bound to the CPUs of
+ * the node in turn.
+ */
+static unsigned int
+taskq_node_cpu(taskq_t *tq)
+{
+	const struct cpumask *mask = cpumask_of_node(tq->tq_node);
+	unsigned int cpu, ncpus = 0, skip;
+
+	for_each_cpu_and(cpu, mask, cpu_online_mask)
+		ncpus++;
+	if (ncpus == 0)
+		return (nr_cpu_ids);
+
+	skip = tq->tq_node_next++ % ncpus;
+	for_each_cpu_and(cpu, mask, cpu_online_mask) {
+		if (skip-- == 0)
+			return (cpu);
+	}
+
+	return (nr_cpu_ids);
+}
+
 static taskq_thread_t *
 taskq_thread_create(taskq_t *tq)
 {
@@ -1176,7 +1202,11 @@ taskq_thread_create(taskq_t *tq)
 		return (NULL);
 	}
 
-	if (spl_taskq_thread_bind) {
+	if (tq->tq_node != NUMA_NO_NODE) {
+		unsigned int cpu = taskq_node_cpu(tq);
+		if (cpu < nr_cpu_ids)
+			kthread_bind(tqt->tqt_thread, cpu);
+	} else if (spl_taskq_thread_bind) {
 		last_used_cpu = (last_used_cpu + 1) % num_online_cpus();
 		kthread_bind(tqt->tqt_thread, last_used_cpu);
 	}
@@ -1336,9 +1366,13 @@ taskq_kstats_fini(taskq_t *tq)
 	tq->tq_ksp = NULL;
 }
 
+/*
+ * Create a taskq whose threads are bound to the CPUs of a NUMA node, or
+ * left unbound for NUMA_NO_NODE.
+ */
 taskq_t *
-taskq_create(const char *name, int threads_arg, pri_t pri,
-    int minalloc, int maxalloc, uint_t flags)
+taskq_create_node(const char *name, int threads_arg, pri_t pri,
+    int minalloc, int maxalloc, uint_t flags, int node)
 {
 	taskq_t *tq;
 	taskq_thread_t *tqt;
@@ -1364,6 +1398,8 @@ taskq_create(const char *name, int threads_arg, pri_t pri,
 		return (NULL);
 
 	tq->tq_hp_support = B_FALSE;
+	tq->tq_node = node;
+	tq->tq_node_next = 0;
 
 	if (flags & TASKQ_THREADS_CPU_PCT) {
 		tq->tq_hp_support = B_TRUE;
@@ -1446,6 +1482,15 @@ taskq_create(const char *name, int threads_arg, pri_t pri,
 
 	return (tq);
 }
+EXPORT_SYMBOL(taskq_create_node);
+
+taskq_t *
+taskq_create(const char *name, int threads_arg, pri_t pri,
+    int minalloc, int maxalloc, uint_t flags)
+{
+	return (taskq_create_node(name, threads_arg, pri, minalloc, maxalloc,
+	    flags, NUMA_NO_NODE));
+}
 EXPORT_SYMBOL(taskq_create);
 
 void
@@ -197,6 +197,15 @@ arc_shrinker_count(struct shrinker *shrink, struct shrink_control *sc)
 	 * See also the comment above zfs_arc_shrinker_limit.
 	 */
 	int64_t can_free = btop(arc_evictable_memory());
+
+	/*
+	 * A NUMA aware shrinker is asked about each node separately, so only
+	 * report the share of the ARC that lives on the node.
+	 */
+#ifdef SHRINKER_NUMA_AWARE
+	if (arc_numa_nodes > 1)
+		can_free = arc_numa_node_share(sc->nid, can_free);
+#endif
 	if (current_is_kswapd() && zfs_arc_shrinker_limit)
 		can_free = MIN(can_free, zfs_arc_shrinker_limit);
 	return (can_free);
@@ -216,6 +225,11 @@ arc_shrinker_scan(struct shrinker *shrink, struct shrink_control *sc)
 	 */
 	arc_no_grow = B_TRUE;
 
+#ifdef SHRINKER_NUMA_AWARE
+	/* Have the evict zthr start with the node we are called for. */
+	arc_numa_evict_node(sc->nid);
+#endif
+
 	/*
 	 * Evict the requested number of pages by reducing arc_c and waiting
 	 * for the requested amount of data to be evicted.  To avoid deadlock
@@ -356,8 +370,15 @@ arc_lowmem_init(void)
 	 * reclaim from the arc.  This is done to prevent kswapd from
 	 * swapping out pages when it is preferable to shrink the arc.
 	 */
-	arc_shrinker = spl_register_shrinker("zfs-arc-shrinker",
-	    arc_shrinker_count, arc_shrinker_scan, zfs_arc_shrinker_seeks);
+	if (arc_numa_nodes > 1) {
+		arc_shrinker = spl_register_numa_shrinker("zfs-arc-shrinker",
+		    arc_shrinker_count, arc_shrinker_scan,
+		    zfs_arc_shrinker_seeks);
+	} else {
+		arc_shrinker = spl_register_shrinker("zfs-arc-shrinker",
+		    arc_shrinker_count, arc_shrinker_scan,
+		    zfs_arc_shrinker_seeks);
+	}
 	VERIFY(arc_shrinker);
 
 	arc_set_sys_free(allmem);
@@ -74,6 +74,8 @@ typedef void zfs_bdev_handle_t;
 typedef struct vdev_disk {
 	zfs_bdev_handle_t		*vd_bdh;
 	krwlock_t			vd_lock;
+	hrtime_t			vd_poll_epoch;
+	uint64_t			vd_poll_ns;
 } vdev_disk_t;
 
 /*
@@ -115,6 +117,13 @@ static unsigned int zfs_vdev_failfast_mask = 1;
  */
 static unsigned int zfs_vdev_disk_calling_thread_io = 0;
 
+/*
+ * Share of one CPU, in percent, that a vdev with the "poll" property set may
+ * spend polling for completions each second. Once it's used up, the rest of
+ * that second's I/O is completed by interrupt as usual.
+ */
+static unsigned int zfs_vdev_disk_poll_pct = 10;
+
 /*
  * Convert SPA mode flags into bdev open mode flags.
  */
@@ -697,6 +706,8 @@ typedef struct {
 	struct bio	*vbio_bio;	/* pointer to the current bio */
 	int		vbio_flags;	/* bio flags */
 	boolean_t	vbio_wait;	/* wait for completion */
+	boolean_t	vbio_poll;	/* poll for completion */
+	struct task_struct *vbio_waiter; /* polling task, until complete */
 } vbio_t;
 
 static vbio_t *
@@ -714,11 +725,14 @@ vbio_alloc(zio_t *zio, struct block_device *bdev, int flags)
 	vbio->vbio_bio = NULL;
 	vbio->vbio_flags = flags;
 	vbio->vbio_wait = B_FALSE;
+	vbio->vbio_poll = B_FALSE;
+	vbio->vbio_waiter = NULL;
 
 	return (vbio);
 }
 
 static void vbio_completion(struct bio *bio);
+static void vbio_poll_completion(struct bio *bio);
 
 static int
 vbio_add_page(vbio_t *vbio, struct page *page, uint_t size, uint_t offset)
@@ -803,10 +817,16 @@ vbio_submit(vbio_t *vbio, abd_t *abd, uint64_t size)
 	 * Once submitted, vbio_bio now owns vbio (through bi_private) and we
 	 * can't touch it again. The bio may complete and vbio_completion() be
 	 * called and free the vbio before this task is run again, so we must
-	 * consider it invalid from this point.
+	 * consider it invalid from this point. The exception is a polled
+	 * vbio, which is only completed by vbio_poll() on this thread.
 	 */
 
-	if (vbio->vbio_wait) {
+	if (vbio->vbio_poll) {
+		vbio->vbio_waiter = current;
+		vbio->vbio_bio->bi_end_io = vbio_poll_completion;
+		vbio->vbio_bio->bi_private = vbio;
+		vdev_submit_bio(vbio->vbio_bio);
+	} else if (vbio->vbio_wait) {
 		vdev_submit_bio_wait(vbio->vbio_bio);
 	} else {
 		vbio->vbio_bio->bi_end_io = vbio_completion;
@@ -844,12 +864,105 @@ vbio_completion(struct bio *bio)
 	ASSERT0P(zio->io_bio);
 	zio->io_bio = vbio;
 
-	/* Using calling thread io, don't dispatch zio. */
-	if (vbio->vbio_wait)
-		zio_execute(zio);
-	else
+	/*
+	 * Using calling thread io, don't dispatch zio.  We are on the
+	 * submitting thread, so the waiter may take the completion.
+	 */
+	if (vbio->vbio_wait) {
+		if (!zio_inline_complete(zio))
+			zio_execute(zio);
+	} else {
 		zio_delay_interrupt(zio);
+	}
+
+}
+
+/*
+ * Polled IO completion callback. The bio is left for vbio_poll() to finish
+ * off on the submitting thread; all we do here is wake it if it's asleep.
+ */
+static void
+vbio_poll_completion(struct bio *bio)
+{
+	vbio_t *vbio = bio->bi_private;
+	struct task_struct *waiter = vbio->vbio_waiter;
+
+	WRITE_ONCE(vbio->vbio_waiter, NULL);
+	wake_up_process(waiter);
+}
+
+#ifdef HAVE_BIO_POLL
+/*
+ * Decide whether to submit this zio with REQ_POLLED. We only poll when the
+ * zio is issued by the thread that wants the result, that is when it is a
+ * sync read or ZIL write that bypassed the vdev queue, and only when it will
+ * fit in a single bio, as the kernel only polls for the bio it's handed.
+ */
+static boolean_t
+vdev_disk_poll_ok(zio_t *zio, vdev_disk_t *vd, vbio_t *vbio)
+{
+	if (!zio->io_vd->vdev_poll ||
+	    !(zio->io_flags & ZIO_FLAG_BYPASSED_QUEUE))
+		return (B_FALSE);
+
+	if (zio->io_priority != ZIO_PRIORITY_SYNC_READ &&
+	    zio->io_priority != ZIO_PRIORITY_SYNC_WRITE)
+		return (B_FALSE);
+
+	/* A buffer of n bytes spans at most n / PAGESIZE + 2 pages. */
+	if (zio->io_size > vbio->vbio_max_bytes ||
+	    zio->io_size / PAGESIZE + 2 > vbio->vbio_max_segs)
+		return (B_FALSE);
+
+	hrtime_t now = gethrtime();
+	if (now - vd->vd_poll_epoch >= NANOSEC) {
+		vd->vd_poll_epoch = now;
+		vd->vd_poll_ns = 0;
+	}
 
+	return (vd->vd_poll_ns <
+	    (uint64_t)zfs_vdev_disk_poll_pct * (NANOSEC / 100));
+}
+#endif
+
+/*
+ * Wait for a polled vbio to complete, then complete the zio on this thread.
+ * The block layer drops REQ_POLLED if the device has no poll queues or the
+ * bio had to be split, in which case the completion arrives by interrupt and
+ * we just sleep until it does.
+ */
+static void
+vbio_poll(vbio_t *vbio, vdev_disk_t *vd)
+{
+	struct bio *bio = vbio->vbio_bio;
+	zio_t *zio = vbio->vbio_zio;
+	boolean_t polled = B_FALSE;
+	hrtime_t start = gethrtime();
+
+	for (;;) {
+		set_current_state(TASK_UNINTERRUPTIBLE);
+		if (READ_ONCE(vbio->vbio_waiter) == NULL)
+			break;
+#ifdef HAVE_BIO_POLL
+		if (bio->bi_opf & REQ_POLLED) {
+			polled = B_TRUE;
+			if (bio_poll(bio, NULL, 0) == 0) {
+				__set_current_state(TASK_RUNNING);
+				cond_resched();
+			}
+			continue;
+		}
+#endif
+		io_schedule();
+	}
+	__set_current_state(TASK_RUNNING);
+
+	if (polled) {
+		atomic_add_64(&vd->vd_poll_ns, gethrtime() - start);
+		zio->io_flags |= ZIO_FLAG_POLLED;
+	}
+
+	vbio_completion(bio);
 }
 
 /*
@@ -941,7 +1054,7 @@ vdev_disk_check_alignment(abd_t *abd, uint64_t size, struct block_device *bdev)
 }
 
 static int
-vdev_disk_io_rw(zio_t *zio)
+vdev_disk_io_rw(zio_t *zio, vbio_t **pollp)
 {
 	vdev_t *v = zio->io_vd;
 	vdev_disk_t *vd = v->vdev_tsd;
@@ -1008,6 +1121,14 @@ vdev_disk_io_rw(zio_t *zio)
 		vbio->vbio_abd = abd;
 
 	boolean_t bio_wait = B_FALSE;
+	zio->io_flags &= ~ZIO_FLAG_POLLED;
+#ifdef HAVE_BIO_POLL
+	if (vdev_disk_poll_ok(zio, vd, vbio)) {
+		vbio->vbio_flags |= REQ_POLLED;
+		vbio->vbio_wait = vbio->vbio_poll = B_TRUE;
+		*pollp = vbio;
+	} else
+#endif
 	if (zfs_vdev_disk_calling_thread_io &&
 	    (zio->io_flags & ZIO_FLAG_BYPASSED_QUEUE)) {
 		vbio->vbio_wait = bio_wait = B_TRUE;
@@ -1238,15 +1359,24 @@ vdev_disk_io_start(zio_t *zio)
 		return;
 
 	case ZIO_TYPE_READ:
-	case ZIO_TYPE_WRITE:
+	case ZIO_TYPE_WRITE: {
+		vbio_t *vbio = NULL;
+
 		zio->io_target_timestamp = zio_handle_io_delay(zio);
-		error = vdev_disk_io_rw(zio);
+		error = vdev_disk_io_rw(zio, &vbio);
 		rw_exit(&vd->vd_lock);
 		if (error) {
 			zio->io_error = error;
 			zio_interrupt(zio);
+		} else if (vbio != NULL) {
+			/*
+			 * Polled; wait and complete outside vd_lock, as the
+			 * zio pipeline may come back through here.
+			 */
+			vbio_poll(vbio, vd);
 		}
 		return;
+	}
 
 	default:
 		/*
@@ -1413,3 +1543,6 @@ ZFS_MODULE_PARAM(zfs_vdev_disk, zfs_vdev_disk_, max_segs, UINT, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs_vdev_disk, zfs_vdev_disk_, calling_thread_io, UINT,
 	ZMOD_RW, "Enable calling thread io");
+
+ZFS_MODULE_PARAM(zfs_vdev_disk, zfs_vdev_disk_, poll_pct, UINT, ZMOD_RW,
+	"Percent of a CPU each vdev may spend polling for I/O completion");
@@ -368,6 +368,15 @@ mappedread(znode_t *zp, int nbytes, zfs_uio_t *uio)
 
 static unsigned long zfs_delete_blocks = DMU_MAX_DELETEBLKCNT;
 
+/*
+ * When set, data faulted into the page cache through an mmap is read from
+ * the DMU as uncached I/O.  Once every page of a record has been copied into
+ * the page cache the ARC copy is released, so mmap'ed data is held only
+ * once.  Records that were already cached, e.g. because they are also
+ * accessed with read(2), stay in the ARC as usual.
+ */
+static int zfs_mmap_uncached = 0;
+
 /*
  * Write the bytes to a file.
  *
@@ -1609,6 +1618,8 @@ zfs_readdir(struct inode *ip, struct dir_context *ctx, cred_t *cr)
 	zap_attribute_t	*zap;
 	int		error;
 	uint8_t		prefetch;
+	uint64_t	*pf_objs = NULL;
+	uint_t		pf_count = 0;
 	uint8_t		type;
 	int		done = 0;
 	uint64_t	parent;
@@ -1631,6 +1642,10 @@ zfs_readdir(struct inode *ip, struct dir_context *ctx, cred_t *cr)
 	os = zfsvfs->z_os;
 	offset = ctx->pos;
 	prefetch = zp->z_zn_prefetch;
+	if (prefetch && zfs_readdir_prefetch_bytes != 0) {
+		pf_objs = kmem_alloc(ZFS_READDIR_PREFETCH_BATCH *
+		    sizeof (uint64_t), KM_SLEEP);
+	}
 	zap = zap_attribute_long_alloc();
 
 	/*
@@ -1704,6 +1719,10 @@ zfs_readdir(struct inode *ip, struct dir_context *ctx, cred_t *cr)
 
 			objnum = ZFS_DIRENT_OBJ(zap->za_first_integer);
 			type = ZFS_DIRENT_TYPE(zap->za_first_integer);
+			if (pf_objs != NULL &&
+			    (type == DT_REG || type == DT_DIR)) {
+				pf_objs[pf_count++] = objnum;
+			}
 		}
 
 		done = !dir_emit(ctx, zap->za_name, strlen(zap->za_name),
@@ -1713,6 +1732,10 @@ zfs_readdir(struct inode *ip, struct dir_context *ctx, cred_t *cr)
 
 		if (prefetch)
 			dmu_prefetch_dnode(os, objnum, ZIO_PRIORITY_SYNC_READ);
+		if (pf_count == ZFS_READDIR_PREFETCH_BATCH) {
+			zfs_readdir_prefetch(os, pf_objs, pf_count);
+			pf_count = 0;
+		}
 
 		/*
 		 * Move to the next entry, fill in the previous offset.
@@ -1728,6 +1751,11 @@ zfs_readdir(struct inode *ip, struct dir_context *ctx, cred_t *cr)
 	zp->z_zn_prefetch = B_FALSE; /* a lookup will re-enable pre-fetching */
 
 update:
+	if (pf_objs != NULL) {
+		zfs_readdir_prefetch(os, pf_objs, pf_count);
+		kmem_free(pf_objs, ZFS_READDIR_PREFETCH_BATCH *
+		    sizeof (uint64_t));
+	}
 	zap_cursor_fini(&zc);
 	zap_attribute_free(zap);
 	if (error == ENOENT)
@@ -4227,9 +4255,13 @@ zfs_fillpage(struct inode *ip, struct page *pp)
 	if (io_off + io_len > i_size)
 		io_len = i_size - io_off;
 
+	dmu_flags_t flags = DMU_READ_PREFETCH;
+	if (zfs_mmap_uncached)
+		flags |= DMU_UNCACHEDIO;
+
 	void *va = kmap(pp);
 	int error = dmu_read(zfsvfs->z_os, zp->z_id, io_off,
-	    io_len, va, DMU_READ_PREFETCH);
+	    io_len, va, flags);
 	if (io_len != PAGE_SIZE)
 		memset((char *)va + io_len, 0, PAGE_SIZE - io_len);
 	kunmap(pp);
@@ -4514,4 +4546,8 @@ EXPORT_SYMBOL(zfs_map);
 
 module_param(zfs_delete_blocks, ulong, 0644);
 MODULE_PARM_DESC(zfs_delete_blocks, "Delete files larger than N blocks async");
+
+module_param(zfs_mmap_uncached, int, 0644);
+MODULE_PARM_DESC(zfs_mmap_uncached,
+	"Do not keep mmap'ed data in the ARC once it is in the page cache");
 #endif
@@ -211,6 +211,30 @@ zpl_file_accessed(struct file *filp)
 	}
 }
 
+static void
+zpl_aio_complete(struct kiocb *kiocb, long ret)
+{
+#if defined(HAVE_KIOCB_KI_COMPLETE_2ARGS)
+	kiocb->ki_complete(kiocb, ret);
+#else
+	kiocb->ki_complete(kiocb, ret, 0);
+#endif
+}
+
+/*
+ * Completion of a read started by zfs_read_async().
+ */
+static void
+zpl_aio_read_done(void *arg, int error, ssize_t nread)
+{
+	struct kiocb *kiocb = arg;
+
+	if (error == 0)
+		kiocb->ki_pos += nread;
+
+	zpl_aio_complete(kiocb, error ? -error : nread);
+}
+
 static ssize_t
 zpl_iter_read(struct kiocb *kiocb, struct iov_iter *to)
 {
@@ -219,14 +243,35 @@ zpl_iter_read(struct kiocb *kiocb, struct iov_iter *to)
 	struct file *filp = kiocb->ki_filp;
 	ssize_t count = iov_iter_count(to);
 	zfs_uio_t uio;
+	int error = EAGAIN;
 
 	zfs_uio_iov_iter_init(&uio, to, kiocb->ki_pos, count);
 
 	crhold(cr);
 	cookie = spl_fstrans_mark();
 
-	ssize_t ret = -zfs_read(ITOZ(filp->f_mapping->host), &uio,
-	    filp->f_flags | zfs_io_flags(kiocb), cr);
+	/*
+	 * An asynchronous Direct I/O read is completed through ki_complete()
+	 * once the data is read, so the kiocb must not be touched after it
+	 * was queued.  Anything zfs_read_async() can't handle without
+	 * blocking is read synchronously.
+	 */
+	if (!is_sync_kiocb(kiocb)) {
+		error = zfs_read_async(ITOZ(filp->f_mapping->host), &uio,
+		    filp->f_flags | zfs_io_flags(kiocb), cr,
+		    zpl_aio_read_done, kiocb);
+		if (error == 0)
+			zpl_file_accessed(filp);
+	}
+
+	ssize_t ret;
+	if (error == 0)
+		ret = -EIOCBQUEUED;
+	else if (error != EAGAIN)
+		ret = -error;
+	else
+		ret = -zfs_read(ITOZ(filp->f_mapping->host), &uio,
+		    filp->f_flags | zfs_io_flags(kiocb), cr);
 
 	spl_fstrans_unmark(cookie);
 	crfree(cr);
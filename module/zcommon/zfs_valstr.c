@@ -222,6 +222,8 @@ _VALSTR_BITFIELD_IMPL(zio_flag,
 	{ '.', "EX", "REEXECUTED" },
 	{ '.', "DG", "DELEGATED" },
 	{ '.', "PA", "PREALLOCATED" },
+	{ '.', "PS", "POSTREAD" },
+	{ '.', "PL", "POLLED" },
 )
 
 /*
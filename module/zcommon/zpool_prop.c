@@ -570,6 +570,9 @@ vdev_prop_init(void)
 	    VDEV_SCHEDULER_AUTO, PROP_DEFAULT, ZFS_TYPE_VDEV,
 	    "auto | on | off", "IO_SCHEDULER",
 	    vdevschedulertype_table, sfeatures);
+	zprop_register_index(VDEV_PROP_POLL, "poll", B_FALSE,
+	    PROP_DEFAULT, ZFS_TYPE_VDEV, "on | off", "POLL", boolean_table,
+	    sfeatures);
 	zprop_register_index(VDEV_PROP_ALLOC_BIAS, "alloc_bias",
 	    VDEV_BIAS_NONE, PROP_DEFAULT, ZFS_TYPE_VDEV,
 	    "none | log | special | dedup", "ALLOC_BIAS",
@@ -98,7 +98,9 @@
  *
  * buf_hash_find() returns the appropriate mutex (held) when it
  * locates the requested buffer in the hash table.  It returns
- * NULL for the mutex if the buffer was not in the table.
+ * NULL for the mutex if the buffer was not in the table.  Lookups
+ * which land on an empty bucket do not take the mutex at all (see
+ * zfs_arc_lockless_lookup).
  *
  * buf_hash_remove() expects the appropriate hash mutex to be
  * already held before it is invoked.
@@ -295,6 +297,11 @@
 #include <sys/vdev.h>
 #include <sys/vdev_impl.h>
 #include <sys/dsl_pool.h>
+#include <sys/dsl_dataset.h>
+#include <sys/dsl_dir.h>
+#include <sys/dsl_synctask.h>
+#include <sys/dmu_objset.h>
+#include <sys/zap.h>
 #include <sys/multilist.h>
 #include <sys/abd.h>
 #include <sys/dbuf.h>
@@ -436,6 +443,25 @@ static uint_t zfs_arc_grow_retry = 0;
 static uint_t zfs_arc_shrink_shift = 0;
 uint_t zfs_arc_average_blocksize = 8 * 1024; /* 8KB */
 
+/*
+ * Resolve hash table lookups which land on an empty bucket without taking
+ * the hash lock.  See buf_hash_find().
+ */
+static int zfs_arc_lockless_lookup = 1;
+
+/*
+ * Scan-resistant admission filter, see arc_admit().
+ */
+static int zfs_arc_admission_filter = 0;
+static uint_t zfs_arc_admission_threshold = 2;
+
+/*
+ * Persistent warm-start of the ARC, see arc_warm_start().
+ */
+static int zfs_arc_warm_enabled = 0;
+static uint_t zfs_arc_warm_max_blocks = 65536;
+static uint_t zfs_arc_warm_rate = 1024;
+
 /*
  * ARC dirty data constraints for arc_tempreserve_space() throttle:
  * * total dirty data limit
@@ -491,6 +517,74 @@ static taskq_t *arc_flush_taskq;
  */
 static uint_t zfs_arc_evict_threads = 0;
 
+/*
+ * When set, the ARC keeps the buffers of each NUMA node on their own
+ * sublists, and the Linux shrinker asks it to free memory per node.  The
+ * evict zthr then evicts from the node under memory pressure before it
+ * evicts from the others.  Read once, at module load.
+ */
+static int zfs_arc_evict_numa = B_FALSE;
+
+/*
+ * When non-zero, buffers that would be expensive to read back from the pool
+ * are kept for this many milliseconds per unit of estimated refetch cost
+ * beyond their last access before eviction will consider them, as long as
+ * cheaper buffers are available.  See arc_hdr_set_cost().
+ */
+static uint_t zfs_arc_evict_cost_ms = 0;
+
+/*
+ * Refetch cost of a block in units of zfs_arc_evict_cost_ms.  Blocks on
+ * solid state or special class vdevs are cheap, blocks on rotational vdevs
+ * cost one unit for the seek plus one per ARC_COST_SIZE bytes transferred.
+ */
+#define	ARC_COST_SIZE	(128 * 1024)
+#define	ARC_COST_MAX	8
+
+/*
+ * Number of NUMA nodes the ARC tells apart, 1 unless zfs_arc_evict_numa is
+ * set on a NUMA system.  arc_node_size[] holds the size of the ARC data
+ * buffers of each node, and arc_node_share[] each node's part of the total
+ * in 1/65536 units, as last computed by arc_numa_update().
+ * arc_evict_node_hint is one more than the node that the shrinker last
+ * reported memory pressure on, or 0.
+ */
+uint_t arc_numa_nodes = 1;
+static wmsum_t *arc_node_size;
+static uint32_t *arc_node_share;
+static uint_t arc_evict_node_hint;
+static int arc_evict_cur_node = -1;
+
+/*
+ * Returns the NUMA node of the current CPU, which is where the kernel
+ * allocates the pages of a new buffer by default.
+ */
+static inline uint8_t
+arc_cur_node(void)
+{
+	return (arc_numa_nodes > 1 ? CPU_NODEID % arc_numa_nodes : 0);
+}
+
+/*
+ * Returns the range of sublists of a multilist that hold the buffers of
+ * a NUMA node.  Every sublist belongs to exactly one node.
+ */
+static inline void
+arc_node_sublists(unsigned int num_sublists, unsigned int node,
+    unsigned int *first, unsigned int *count)
+{
+	unsigned int nodes = MIN(arc_numa_nodes, num_sublists);
+
+	if (nodes <= 1) {
+		*first = 0;
+		*count = num_sublists;
+		return;
+	}
+	node %= nodes;
+	*first = node * num_sublists / nodes;
+	*count = (node + 1) * num_sublists / nodes - *first;
+}
+
 /* The 7 states: */
 static arc_state_t ARC_anon;
 /*  */ arc_state_t ARC_mru;
@@ -526,6 +620,8 @@ arc_stats_t arc_stats = {
 	{ "access_skip",		KSTAT_DATA_UINT64 },
 	{ "evict_skip",			KSTAT_DATA_UINT64 },
 	{ "evict_not_enough",		KSTAT_DATA_UINT64 },
+	{ "evict_cost_skip",		KSTAT_DATA_UINT64 },
+	{ "evict_numa_local",		KSTAT_DATA_UINT64 },
 	{ "evict_l2_cached",		KSTAT_DATA_UINT64 },
 	{ "evict_l2_eligible",		KSTAT_DATA_UINT64 },
 	{ "evict_l2_eligible_mfu",	KSTAT_DATA_UINT64 },
@@ -537,6 +633,8 @@ arc_stats_t arc_stats = {
 	{ "hash_collisions",		KSTAT_DATA_UINT64 },
 	{ "hash_chains",		KSTAT_DATA_UINT64 },
 	{ "hash_chain_max",		KSTAT_DATA_UINT64 },
+	{ "hash_lookup_lockless",	KSTAT_DATA_UINT64 },
+	{ "hash_lookup_locked",		KSTAT_DATA_UINT64 },
 	{ "meta",			KSTAT_DATA_UINT64 },
 	{ "pd",				KSTAT_DATA_UINT64 },
 	{ "pm",				KSTAT_DATA_UINT64 },
@@ -605,6 +703,13 @@ arc_stats_t arc_stats = {
 	{ "l2_evict_lock_retry",	KSTAT_DATA_UINT64 },
 	{ "l2_evict_reading",		KSTAT_DATA_UINT64 },
 	{ "l2_evict_l1cached",		KSTAT_DATA_UINT64 },
+	{ "l2_evict_bytes",		KSTAT_DATA_UINT64 },
+	{ "l2_retain_bytes",		KSTAT_DATA_UINT64 },
+	{ "l2_retain_bufs",		KSTAT_DATA_UINT64 },
+	{ "l2_write_ctl_rate",		KSTAT_DATA_UINT64 },
+	{ "l2_write_ctl_hit_rate",	KSTAT_DATA_UINT64 },
+	{ "l2_write_ctl_latency",	KSTAT_DATA_UINT64 },
+	{ "l2_write_ctl_busy",		KSTAT_DATA_UINT64 },
 	{ "l2_free_on_write",		KSTAT_DATA_UINT64 },
 	{ "l2_abort_lowmem",		KSTAT_DATA_UINT64 },
 	{ "l2_cksum_bad",		KSTAT_DATA_UINT64 },
@@ -651,6 +756,8 @@ arc_stats_t arc_stats = {
 	{ "arc_sys_free",		KSTAT_DATA_UINT64 },
 	{ "arc_raw_size",		KSTAT_DATA_UINT64 },
 	{ "cached_only_in_progress",	KSTAT_DATA_UINT64 },
+	{ "admission_accepted",		KSTAT_DATA_UINT64 },
+	{ "admission_rejected",		KSTAT_DATA_UINT64 },
 	{ "abd_chunk_waste_size",	KSTAT_DATA_UINT64 },
 };
 
@@ -832,6 +939,8 @@ typedef struct arc_async_flush {
 #define	L2ARC_HEADROOM_BOOST	200
 #define	L2ARC_FEED_SECS		1		/* caching interval secs */
 #define	L2ARC_FEED_MIN_MS	200		/* min caching interval ms */
+#define	L2ARC_WCTL_PERIOD	10		/* write throttle sample secs */
+#define	L2ARC_WCTL_MIN_SHIFT	4		/* min rate is write_max >> 4 */
 
 /*
  * Min L2ARC capacity to enable persistent markers, adaptive intervals, and
@@ -856,6 +965,24 @@ static int l2arc_feed_again = B_TRUE;		/* turbo warmup */
 static int l2arc_norw = B_FALSE;		/* no reads during writes */
 static uint_t l2arc_meta_percent = 33;	/* limit on headers size */
 
+/*
+ * Adaptive L2ARC write throttle
+ * l2arc_write_adaptive : A ZFS module parameter.  When set, the rate at
+ * 		which each cache device is fed is steered between
+ * 		l2arc_write_max >> L2ARC_WCTL_MIN_SHIFT and l2arc_write_max.
+ * 		Every L2ARC_WCTL_PERIOD seconds the change in L2ARC read hits
+ * 		is compared with the change in bytes written: the rate keeps
+ * 		going up while the extra writes still buy at least
+ * 		l2arc_write_gain_pct bytes of hits per 100 bytes written, and
+ * 		goes down otherwise.  The DWPD limit still applies on top.
+ * l2arc_write_busy_pct : A ZFS module parameter.  The rate is halved
+ * 		whenever the average time to complete a feed's writes exceeds
+ * 		this percentage of the feed interval.
+ */
+static int l2arc_write_adaptive = B_FALSE;
+static uint_t l2arc_write_busy_pct = 50;
+static uint_t l2arc_write_gain_pct = 5;
+
 /*
  * L2ARC Internals
  */
@@ -919,6 +1046,8 @@ static void arc_hdr_destroy(arc_buf_hdr_t *);
 static void arc_access(arc_buf_hdr_t *, arc_flags_t, boolean_t);
 static void arc_buf_watch(arc_buf_t *);
 static void arc_change_state(arc_state_t *, arc_buf_hdr_t *);
+static void arc_warm_note(spa_t *, const zbookmark_phys_t *, const blkptr_t *);
+static void arc_numa_update(void);
 
 static arc_buf_contents_t arc_buf_type(arc_buf_hdr_t *);
 static uint32_t arc_bufc_to_flags(arc_buf_contents_t);
@@ -931,6 +1060,8 @@ static void l2arc_do_free_on_write(l2arc_dev_t *dev);
 static void l2arc_hdr_arcstats_update(arc_buf_hdr_t *hdr, boolean_t incr,
     boolean_t state_only);
 static uint64_t l2arc_get_write_rate(l2arc_dev_t *dev);
+static void l2arc_write_ctl_update(l2arc_dev_t *dev, hrtime_t lat,
+    uint64_t asize);
 
 static void arc_prune_async(uint64_t adjust);
 
@@ -990,6 +1121,22 @@ static uint64_t l2arc_meta_cycles = 2;
  */
 static uint64_t l2arc_trim_ahead = 0;
 
+/*
+ * L2ARC hot buffer retention
+ * l2arc_retain_hits : A ZFS module parameter.  When non-zero, L2-only
+ * 		buffers in the region about to be evicted which have been hit
+ * 		at least this many times since they were written are read
+ * 		back and written again at the write hand, instead of being
+ * 		dropped.  The default is 0, which disables retention.
+ * 		Retention is not done while l2arc_trim_ahead is set, as the
+ * 		region has already been trimmed by the time it is evicted.
+ * l2arc_retain_pct : A ZFS module parameter that limits the retained
+ * 		buffers to this percentage of each write, so that blocks
+ * 		new to the L2ARC keep being written.
+ */
+static uint_t l2arc_retain_hits = 0;
+static uint_t l2arc_retain_pct = 50;
+
 /*
  * Performance tuning of L2ARC persistence:
  *
@@ -1036,6 +1183,8 @@ boolean_t l2arc_log_blkptr_valid(l2arc_dev_t *dev,
     const l2arc_log_blkptr_t *lbp);
 static boolean_t l2arc_log_blk_insert(l2arc_dev_t *dev,
     const arc_buf_hdr_t *ab);
+static void l2arc_hdr_to_log_ent(const arc_buf_hdr_t *hdr,
+    l2arc_log_ent_phys_t *le);
 boolean_t l2arc_range_check_overlap(uint64_t bottom,
     uint64_t top, uint64_t check);
 static void l2arc_blk_fetch_done(zio_t *zio);
@@ -1081,6 +1230,23 @@ buf_hash_find(uint64_t spa, const blkptr_t *bp, kmutex_t **lockp)
 	kmutex_t *hash_lock = BUF_HASH_LOCK(idx);
 	arc_buf_hdr_t *hdr;
 
+	/*
+	 * The table is sized for all of memory filled with small blocks, so
+	 * most lookups that miss land on an empty bucket.  Those are answered
+	 * without the hash lock: headers are only linked into a bucket while
+	 * holding it, so an insert racing with us is indistinguishable from
+	 * one which happens just after we return.  Non-empty chains are
+	 * always walked under the lock, since headers are not type-stable
+	 * once they have been returned to the kmem cache.
+	 */
+	if (zfs_arc_lockless_lookup &&
+	    atomic_load_ptr(&buf_hash_table.ht_table[idx]) == NULL) {
+		ARCSTAT_BUMP(arcstat_hash_lookup_lockless);
+		*lockp = NULL;
+		return (NULL);
+	}
+
+	ARCSTAT_BUMP(arcstat_hash_lookup_locked);
 	mutex_enter(hash_lock);
 	for (hdr = buf_hash_table.ht_table[idx]; hdr != NULL;
 	    hdr = hdr->b_hash_next) {
@@ -1167,6 +1333,146 @@ buf_hash_remove(arc_buf_hdr_t *hdr)
 		ARCSTAT_BUMPDOWN(arcstat_hash_chains);
 }
 
+/*
+ * ARC admission filter.
+ *
+ * A scan streams a large number of blocks through the ARC which are read
+ * exactly once, and each of them still enters the MRU state and pushes out
+ * blocks which would have been reused.  When zfs_arc_admission_filter is
+ * set, data blocks which miss in both the ARC and its ghost lists are only
+ * cached once they have been requested zfs_arc_admission_threshold times in
+ * the recent past, as estimated by a count-min sketch keyed by buf_hash().
+ * Rejected blocks are read into the uncached state, so they are evicted as
+ * soon as their last reference is dropped.  The filter is never applied to
+ * metadata, and only kicks in once the ARC has grown to its target size.
+ *
+ * The sketch packs sixteen 4-bit counters into each 64-bit word.  A key
+ * increments one counter in each of ARC_SKETCH_DEPTH words and its estimate
+ * is the smallest of those counters.  All counters are halved whenever the
+ * number of increments reaches ARC_SKETCH_SAMPLE times the number of words,
+ * so that the estimate follows recent rather than all-time frequency.
+ * Updates are lock-free and the aging pass may lose a few concurrent
+ * increments, which is fine for an estimate.
+ *
+ * The sketch is only allocated once the filter is first enabled, and both
+ * the allocation and the aging pass are done by the arc_reap thread in
+ * arc_sketch_maintain(), not by readers.  Until the sketch exists, or while
+ * aging is pending, blocks are admitted as usual or slightly over-counted.
+ */
+#define	ARC_SKETCH_DEPTH	4
+#define	ARC_SKETCH_SAMPLE	40
+#define	ARC_SKETCH_CTR_MAX	15
+
+static uint64_t *volatile arc_sketch;
+static uint64_t arc_sketch_mask;
+static uint64_t arc_sketch_incrs;
+static boolean_t arc_sketch_age_pending;
+
+static const uint64_t arc_sketch_seeds[ARC_SKETCH_DEPTH] = {
+	0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL,
+	0x9ae16a3b2f90404fULL, 0xcbf29ce484222325ULL
+};
+
+/*
+ * Called from the arc_reap thread about once a second to allocate the sketch
+ * when the filter has been enabled, and to age it when updates asked for it.
+ */
+static void
+arc_sketch_maintain(void)
+{
+	uint64_t *sketch = arc_sketch;
+
+	if (sketch == NULL) {
+		if (!zfs_arc_admission_filter)
+			return;
+		sketch = vmem_zalloc((arc_sketch_mask + 1) *
+		    sizeof (uint64_t), KM_SLEEP);
+		membar_producer();
+		arc_sketch = sketch;
+		return;
+	}
+
+	if (!arc_sketch_age_pending)
+		return;
+	arc_sketch_age_pending = B_FALSE;
+	for (uint64_t i = 0; i <= arc_sketch_mask; i++)
+		sketch[i] = (sketch[i] >> 1) & 0x7777777777777777ULL;
+}
+
+/*
+ * Record an access to the given key and return its estimated frequency,
+ * including this access.
+ */
+static uint_t
+arc_sketch_update(uint64_t *sketch, uint64_t key)
+{
+	uint_t est = ARC_SKETCH_CTR_MAX;
+
+	for (int d = 0; d < ARC_SKETCH_DEPTH; d++) {
+		uint64_t h = (key + arc_sketch_seeds[d]) * arc_sketch_seeds[d];
+		h ^= h >> 29;
+		volatile uint64_t *wp = &sketch[h & arc_sketch_mask];
+		uint_t shift = (h >> 60) << 2;
+		uint64_t w, nw;
+		uint_t ctr;
+
+		do {
+			w = *wp;
+			ctr = (w >> shift) & ARC_SKETCH_CTR_MAX;
+			if (ctr == ARC_SKETCH_CTR_MAX)
+				break;
+			nw = w + (1ULL << shift);
+		} while (atomic_cas_64(wp, w, nw) != w);
+
+		est = MIN(est, MIN(ctr + 1, ARC_SKETCH_CTR_MAX));
+	}
+
+	if (atomic_inc_64_nv(&arc_sketch_incrs) %
+	    ((arc_sketch_mask + 1) * ARC_SKETCH_SAMPLE) == 0)
+		arc_sketch_age_pending = B_TRUE;
+
+	return (est);
+}
+
+/*
+ * Called on an ARC miss for a data block.  The access is recorded in the
+ * sketch on the first call only, *estp carries the estimate across the
+ * retries of a single arc_read() and must start out as 0.  The return value
+ * is only meaningful when the block was not found in a ghost list (!ghost),
+ * and is B_FALSE if the block should be read into the uncached state instead
+ * of being cached.
+ */
+static boolean_t
+arc_admit(uint64_t spa, const blkptr_t *bp, boolean_t ghost, uint_t *estp)
+{
+	uint64_t *sketch = arc_sketch;
+
+	if (*estp == 0) {
+		if (sketch == NULL)
+			return (B_TRUE);
+		*estp = arc_sketch_update(sketch, buf_hash(spa,
+		    BP_IDENTITY(bp), BP_GET_PHYSICAL_BIRTH(bp)));
+	}
+
+	if (ghost)
+		return (B_TRUE);
+
+	/*
+	 * Everything is admitted while there is still room to grow, so that
+	 * a cold ARC fills up as quickly as it did before.
+	 */
+	if (aggsum_lower_bound(&arc_sums.arcstat_size) <
+	    arc_c - (arc_c >> zfs_arc_no_grow_shift))
+		return (B_TRUE);
+
+	if (*estp >= MIN(zfs_arc_admission_threshold, ARC_SKETCH_CTR_MAX)) {
+		ARCSTAT_BUMP(arcstat_admission_accepted);
+		return (B_TRUE);
+	}
+	ARCSTAT_BUMP(arcstat_admission_rejected);
+	return (B_FALSE);
+}
+
 /*
  * Global data structures and functions for the buf kmem cache.
  */
@@ -1189,6 +1495,11 @@ buf_fini(void)
 	kmem_free(buf_hash_table.ht_table,
 	    (buf_hash_table.ht_mask + 1) * sizeof (void *));
 #endif
+	if (arc_sketch != NULL) {
+		vmem_free(arc_sketch, (arc_sketch_mask + 1) *
+		    sizeof (uint64_t));
+		arc_sketch = NULL;
+	}
 	for (int i = 0; i < BUF_LOCKS; i++)
 		mutex_destroy(BUF_HASH_LOCK(i));
 	kmem_cache_destroy(hdr_full_cache);
@@ -1315,6 +1626,13 @@ retry:
 		goto retry;
 	}
 
+	/*
+	 * The admission filter's sketch has two counters per hash bucket,
+	 * which costs an eighth of the memory used by the hash table.  It is
+	 * allocated by arc_sketch_maintain() once the filter is enabled.
+	 */
+	arc_sketch_mask = MAX(hsize >> 3, 64) - 1;
+
 	hdr_full_cache = kmem_cache_create("arc_buf_hdr_t_full", HDR_FULL_SIZE,
 	    0, hdr_full_cons, hdr_full_dest, NULL, NULL, NULL, KMC_RECLAIMABLE);
 	hdr_l2only_cache = kmem_cache_create("arc_buf_hdr_t_l2only",
@@ -3340,6 +3658,8 @@ arc_hdr_alloc(uint64_t spa, int32_t psize, int32_t lsize,
 	hdr->b_l1hdr.b_mru_ghost_hits = 0;
 	hdr->b_l1hdr.b_mfu_hits = 0;
 	hdr->b_l1hdr.b_mfu_ghost_hits = 0;
+	hdr->b_l1hdr.b_node = arc_cur_node();
+	hdr->b_l1hdr.b_cost = 0;
 	hdr->b_l1hdr.b_buf = NULL;
 
 	ASSERT(zfs_refcount_is_zero(&hdr->b_l1hdr.b_refcnt));
@@ -3380,6 +3700,8 @@ arc_hdr_realloc(arc_buf_hdr_t *hdr, kmem_cache_t *old, kmem_cache_t *new)
 		 * l2c_only even though it's about to change.
 		 */
 		nhdr->b_l1hdr.b_state = arc_l2c_only;
+		nhdr->b_l1hdr.b_node = arc_cur_node();
+		nhdr->b_l1hdr.b_cost = 0;
 
 		/* Verify previous threads set to NULL before freeing */
 		ASSERT0P(nhdr->b_l1hdr.b_pabd);
@@ -3809,9 +4131,12 @@ arc_buf_destroy(arc_buf_t *buf, const void *tag)
  * waiting for it.  For non-ghost states it includes size of evicted data
  * buffers (the headers are not freed there).  For ghost states it includes
  * only the evicted headers size.
+ *
+ * A non-zero cost is the number of ticks per unit of refetch cost that a
+ * buffer is kept past its last access, see zfs_arc_evict_cost_ms.
  */
 static int64_t
-arc_evict_hdr(arc_buf_hdr_t *hdr, uint64_t *real_evicted)
+arc_evict_hdr(arc_buf_hdr_t *hdr, clock_t cost, uint64_t *real_evicted)
 {
 	arc_state_t *evicted_state, *state;
 	int64_t bytes_evicted = 0;
@@ -3879,6 +4204,14 @@ arc_evict_hdr(arc_buf_hdr_t *hdr, uint64_t *real_evicted)
 		return (bytes_evicted);
 	}
 
+	/* buffers that are expensive to read back are kept a while longer */
+	if (cost != 0 && state != arc_uncached && !HDR_HAS_L2HDR(hdr) &&
+	    ddi_get_lbolt() - hdr->b_l1hdr.b_arc_access <
+	    cost * hdr->b_l1hdr.b_cost) {
+		ARCSTAT_BUMP(arcstat_evict_cost_skip);
+		return (bytes_evicted);
+	}
+
 	if (HDR_HAS_L2HDR(hdr)) {
 		ARCSTAT_INCR(arcstat_evict_l2_cached, HDR_GET_LSIZE(hdr));
 	} else {
@@ -3948,7 +4281,7 @@ arc_set_need_free(void)
 
 static uint64_t
 arc_evict_state_impl(multilist_t *ml, int idx, arc_buf_hdr_t *marker,
-    uint64_t spa, uint64_t bytes, boolean_t *more)
+    uint64_t spa, uint64_t bytes, clock_t cost, boolean_t *more)
 {
 	multilist_sublist_t *mls;
 	uint64_t bytes_evicted = 0, real_evicted = 0;
@@ -4011,7 +4344,8 @@ arc_evict_state_impl(multilist_t *ml, int idx, arc_buf_hdr_t *marker,
 
 		if (mutex_tryenter(hash_lock)) {
 			uint64_t revicted;
-			uint64_t evicted = arc_evict_hdr(hdr, &revicted);
+			uint64_t evicted = arc_evict_hdr(hdr, cost,
+			    &revicted);
 			mutex_exit(hash_lock);
 
 			bytes_evicted += evicted;
@@ -4115,6 +4449,7 @@ typedef struct evict_arg {
 	int			eva_idx;
 	uint64_t		eva_spa;
 	uint64_t		eva_bytes;
+	clock_t			eva_cost;
 	uint64_t		eva_evicted;
 } evict_arg_t;
 
@@ -4130,7 +4465,7 @@ arc_evict_task(void *arg)
 	do {
 		total_evicted += arc_evict_state_impl(eva->eva_ml,
 		    eva->eva_idx, eva->eva_marker, eva->eva_spa,
-		    eva->eva_bytes - total_evicted, &more);
+		    eva->eva_bytes - total_evicted, eva->eva_cost, &more);
 	} while (total_evicted < eva->eva_bytes && --batches > 0 && more);
 
 	eva->eva_evicted = total_evicted;
@@ -4253,6 +4588,35 @@ arc_evict_state(arc_state_t *state, arc_buf_contents_t type, uint64_t spa,
 	int sublists_left = num_sublists;
 	int sublist_idx = multilist_get_random_index(ml);
 
+	/*
+	 * Spare the buffers that are expensive to read back on the first
+	 * pass, unless we are flushing.
+	 */
+	clock_t cost = 0;
+	if (zfs_arc_evict_cost_ms != 0 && bytes != ARC_EVICT_ALL && spa == 0)
+		cost = MAX(MSEC_TO_TICK(zfs_arc_evict_cost_ms), 1);
+
+	/*
+	 * If a NUMA node is short of memory, first evict from the sublists
+	 * that hold the buffers of that node, see arc_numa_evict_node().
+	 */
+	if (arc_evict_cur_node >= 0 && bytes != ARC_EVICT_ALL &&
+	    zthr_iscurthread(arc_evict_zthr)) {
+		unsigned int first, count;
+
+		arc_node_sublists(num_sublists, arc_evict_cur_node, &first,
+		    &count);
+		for (unsigned int i = 0; i < count && total_evicted < bytes;
+		    i++) {
+			int idx = first + (sublist_idx + i) % count;
+
+			total_evicted += arc_evict_state_impl(ml, idx,
+			    markers[idx], spa, bytes - total_evicted, cost,
+			    NULL);
+		}
+		ARCSTAT_INCR(arcstat_evict_numa_local, total_evicted);
+	}
+
 	/*
 	 * While we haven't hit our target number of bytes to evict, or
 	 * we're evicting all available buffers.
@@ -4300,6 +4664,7 @@ arc_evict_state(arc_state_t *state, arc_buf_contents_t type, uint64_t spa,
 				eva[i].eva_marker = markers[sublist_idx];
 				eva[i].eva_idx = sublist_idx;
 				eva[i].eva_bytes = evict;
+				eva[i].eva_cost = cost;
 
 				taskq_dispatch_ent(arc_evict_taskq,
 				    arc_evict_task, &eva[i], 0,
@@ -4310,7 +4675,7 @@ arc_evict_state(arc_state_t *state, arc_buf_contents_t type, uint64_t spa,
 
 			bytes_evicted = arc_evict_state_impl(ml, sublist_idx,
 			    markers[sublist_idx], spa, bytes - total_evicted,
-			    NULL);
+			    cost, NULL);
 
 			scan_evicted += bytes_evicted;
 			total_evicted += bytes_evicted;
@@ -4335,7 +4700,21 @@ arc_evict_state(arc_state_t *state, arc_buf_contents_t type, uint64_t spa,
 		 * have no reason to believe we'll evict more during another
 		 * scan, so break the loop.
 		 */
-		if (scan_evicted == 0 && sublists_left == 0) {
+		if (scan_evicted == 0 && sublists_left == 0 && cost != 0) {
+			/*
+			 * Only buffers that are expensive to read back are
+			 * left.  Restart from the tails without sparing them.
+			 */
+			cost = 0;
+			for (int i = 0; i < num_sublists; i++) {
+				multilist_sublist_t *mls;
+
+				mls = multilist_sublist_lock_idx(ml, i);
+				multilist_sublist_remove(mls, markers[i]);
+				multilist_sublist_insert_tail(mls, markers[i]);
+				multilist_sublist_unlock(mls);
+			}
+		} else if (scan_evicted == 0 && sublists_left == 0) {
 			/* This isn't possible, let's make that obvious */
 			ASSERT3S(bytes, !=, 0);
 
@@ -4506,6 +4885,8 @@ arc_evict(void)
 	static uint64_t gsrd, gsrm, gsfd, gsfm;
 	uint64_t ngrd, ngrm, ngfd, ngfm;
 
+	arc_evict_cur_node = (int)atomic_swap_32(&arc_evict_node_hint, 0) - 1;
+
 	/* Get current size of ARC states we can evict from. */
 	mrud = zfs_refcount_count(&arc_mru->arcs_size[ARC_BUFC_DATA]) +
 	    zfs_refcount_count(&arc_anon->arcs_size[ARC_BUFC_DATA]);
@@ -4959,6 +5340,9 @@ arc_reap_cb_check(void *arg, zthr_t *zthr)
 	int64_t free_memory = arc_available_memory();
 	static int reap_cb_check_counter = 0;
 
+	arc_numa_update();
+	arc_sketch_maintain();
+
 	/*
 	 * If a kmem reap is already active, don't schedule more.  We must
 	 * check for this because kmem_cache_reap_soon() won't actually
@@ -5298,6 +5682,8 @@ arc_get_data_impl(arc_buf_hdr_t *hdr, uint64_t size, const void *tag,
 	} else {
 		arc_space_consume(size, ARC_SPACE_DATA);
 	}
+	if (arc_numa_nodes > 1)
+		wmsum_add(&arc_node_size[hdr->b_l1hdr.b_node], size);
 
 	/*
 	 * Update the state size.  Note that ghost states have a
@@ -5374,6 +5760,8 @@ arc_free_data_impl(arc_buf_hdr_t *hdr, uint64_t size, const void *tag)
 		ASSERT(type == ARC_BUFC_DATA);
 		arc_space_return(size, ARC_SPACE_DATA);
 	}
+	if (arc_numa_nodes > 1)
+		wmsum_add(&arc_node_size[hdr->b_l1hdr.b_node], -size);
 }
 
 /*
@@ -5607,6 +5995,37 @@ arc_hdr_verify(arc_buf_hdr_t *hdr, blkptr_t *bp)
 	}
 }
 
+/*
+ * Record the estimated cost of reading the block back from the pool once
+ * the header has been evicted.  The vdev of the first DVA decides: reads from
+ * solid state devices and from the special and dedup classes are considered
+ * free, while reads from rotational devices pay for a seek and the transfer.
+ * Whether a copy is on an L2ARC device is checked at eviction time instead,
+ * see arc_evict_hdr().
+ */
+static void
+arc_hdr_set_cost(arc_buf_hdr_t *hdr, spa_t *spa, const blkptr_t *bp)
+{
+	uint8_t cost = 1 + MIN(BP_GET_PSIZE(bp) / ARC_COST_SIZE,
+	    ARC_COST_MAX - 1);
+
+	ASSERT(HDR_HAS_L1HDR(hdr));
+
+	/*
+	 * Never wait for the config lock from I/O completion, without it the
+	 * rotational estimate is used.
+	 */
+	if (spa_config_tryenter(spa, SCL_VDEV, FTAG, RW_READER)) {
+		vdev_t *vd = vdev_lookup_top(spa, DVA_GET_VDEV(&bp->blk_dva[0]));
+		if (vd != NULL && (vd->vdev_nonrot ||
+		    vd->vdev_alloc_bias == VDEV_BIAS_SPECIAL ||
+		    vd->vdev_alloc_bias == VDEV_BIAS_DEDUP))
+			cost = 0;
+		spa_config_exit(spa, SCL_VDEV, FTAG);
+	}
+	hdr->b_l1hdr.b_cost = cost;
+}
+
 static void
 arc_read_done(zio_t *zio)
 {
@@ -5679,6 +6098,8 @@ arc_read_done(zio_t *zio)
 		if (!HDR_L2_READING(hdr)) {
 			hdr->b_complevel = zio->io_prop.zp_complevel;
 		}
+		if (zfs_arc_evict_cost_ms != 0)
+			arc_hdr_set_cost(hdr, zio->io_spa, bp);
 	}
 
 	arc_hdr_clear_flags(hdr, ARC_FLAG_L2_EVICTED);
@@ -5905,6 +6326,7 @@ arc_read(zio_t *pio, spa_t *spa, const blkptr_t *bp,
 	arc_buf_t *buf = NULL;
 	int rc = 0;
 	boolean_t bp_validation = B_FALSE;
+	uint_t admit_est = 0;
 
 	ASSERT(!embedded_bp ||
 	    BPE_GET_ETYPE(bp) == BP_EMBEDDED_TYPE_DATA);
@@ -6048,9 +6470,27 @@ top:
 		    hdr->b_l1hdr.b_state == arc_mfu ||
 		    hdr->b_l1hdr.b_state == arc_uncached);
 
+		/*
+		 * When a buffer is going to be attached below, take the
+		 * header off its state list before arc_access() rather than
+		 * after it.  An MRU to MFU promotion of an evictable header
+		 * would otherwise remove it from the MRU list, insert it on
+		 * the MFU list and then immediately remove it again, taking
+		 * three sublist locks on what is often the hottest path in
+		 * the ARC.  With the hold in place the promotion only has to
+		 * update the state sizes.
+		 */
+		boolean_t access_hold = (done != NULL && !no_buf);
+		if (access_hold)
+			add_reference(hdr, FTAG);
+
 		DTRACE_PROBE1(arc__hit, arc_buf_hdr_t *, hdr);
 		arc_access(hdr, *arc_flags, B_TRUE);
 
+		boolean_t warm_note = (spa->spa_arc_warm != NULL &&
+		    hdr->b_l1hdr.b_state == arc_mfu &&
+		    !(*arc_flags & ARC_FLAG_PREFETCH));
+
 		if (done && !no_buf) {
 			ASSERT(!embedded_bp || !BP_IS_HOLE(bp));
 
@@ -6082,7 +6522,11 @@ top:
 			ASSERT((zio_flags & ZIO_FLAG_SPECULATIVE) ||
 			    rc != EACCES);
 		}
+		if (access_hold)
+			(void) remove_reference(hdr, FTAG);
 		mutex_exit(hash_lock);
+		if (warm_note)
+			arc_warm_note(spa, zb, bp);
 		ARCSTAT_BUMP(arcstat_hits);
 		ARCSTAT_CONDSTAT(!(*arc_flags & ARC_FLAG_PREFETCH),
 		    demand, prefetch, is_data, data, metadata, hits);
@@ -6099,6 +6543,7 @@ top:
 		abd_t *hdr_abd;
 		int alloc_flags = encrypted_read ? ARC_HDR_ALLOC_RDATA : 0;
 		arc_buf_contents_t type = BP_GET_BUFC_TYPE(bp);
+		boolean_t admit = B_TRUE;
 		int config_lock;
 		int error;
 
@@ -6138,6 +6583,20 @@ top:
 			goto done;
 		}
 
+		if (zfs_arc_admission_filter && !embedded_bp &&
+		    type == ARC_BUFC_DATA &&
+		    !(*arc_flags & ARC_FLAG_UNCACHED)) {
+			/*
+			 * A header that is still cached, as for a raw
+			 * encrypted read, was admitted already.  L2-only
+			 * headers are not ghosts and go through the filter.
+			 */
+			boolean_t ghost = hdr != NULL && HDR_HAS_L1HDR(hdr) &&
+			    GHOST_STATE(hdr->b_l1hdr.b_state);
+			if (hdr == NULL || !HDR_HAS_L1HDR(hdr) || ghost)
+				admit = arc_admit(guid, bp, ghost, &admit_est);
+		}
+
 		if (hdr == NULL) {
 			/*
 			 * This block is not in the cache or it has
@@ -6216,7 +6675,7 @@ top:
 				goto top;
 			}
 		}
-		if (*arc_flags & ARC_FLAG_UNCACHED) {
+		if ((*arc_flags & ARC_FLAG_UNCACHED) || !admit) {
 			arc_hdr_set_flags(hdr, ARC_FLAG_UNCACHED);
 			if (!encrypted_read)
 				alloc_flags |= ARC_HDR_ALLOC_LINEAR;
@@ -6345,6 +6804,8 @@ top:
 				DTRACE_PROBE1(l2arc__hit, arc_buf_hdr_t *, hdr);
 				ARCSTAT_BUMP(arcstat_l2_hits);
 				hdr->b_l2hdr.b_hits++;
+				wmsum_add(&hdr->b_l2hdr.b_dev->l2ad_wctl_hits,
+				    HDR_GET_PSIZE(hdr));
 
 				cb = kmem_zalloc(sizeof (l2arc_read_callback_t),
 				    KM_SLEEP);
@@ -7012,6 +7473,8 @@ arc_write_done(zio_t *zio)
 		} else {
 			hdr->b_dva = *BP_IDENTITY(zio->io_bp);
 			hdr->b_birth = BP_GET_PHYSICAL_BIRTH(zio->io_bp);
+			if (zfs_arc_evict_cost_ms != 0)
+				arc_hdr_set_cost(hdr, zio->io_spa, zio->io_bp);
 		}
 	} else {
 		ASSERT(HDR_EMPTY(hdr));
@@ -7344,6 +7807,10 @@ arc_kstat_update(kstat_t *ksp, int rw)
 	    wmsum_value(&arc_sums.arcstat_evict_skip);
 	as->arcstat_evict_not_enough.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_evict_not_enough);
+	as->arcstat_evict_cost_skip.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_evict_cost_skip);
+	as->arcstat_evict_numa_local.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_evict_numa_local);
 	as->arcstat_evict_l2_cached.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_evict_l2_cached);
 	as->arcstat_evict_l2_eligible.value.ui64 =
@@ -7363,6 +7830,10 @@ arc_kstat_update(kstat_t *ksp, int rw)
 	    wmsum_value(&arc_sums.arcstat_hash_collisions);
 	as->arcstat_hash_chains.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_hash_chains);
+	as->arcstat_hash_lookup_lockless.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_hash_lookup_lockless);
+	as->arcstat_hash_lookup_locked.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_hash_lookup_locked);
 	as->arcstat_size.value.ui64 =
 	    aggsum_value(&arc_sums.arcstat_size);
 	as->arcstat_compressed_size.value.ui64 =
@@ -7464,6 +7935,20 @@ arc_kstat_update(kstat_t *ksp, int rw)
 	    wmsum_value(&arc_sums.arcstat_l2_evict_reading);
 	as->arcstat_l2_evict_l1cached.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_l2_evict_l1cached);
+	as->arcstat_l2_evict_bytes.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_l2_evict_bytes);
+	as->arcstat_l2_retain_bytes.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_l2_retain_bytes);
+	as->arcstat_l2_retain_bufs.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_l2_retain_bufs);
+	as->arcstat_l2_write_ctl_rate.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_l2_write_ctl_rate);
+	as->arcstat_l2_write_ctl_hit_rate.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_l2_write_ctl_hit_rate);
+	as->arcstat_l2_write_ctl_latency.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_l2_write_ctl_latency);
+	as->arcstat_l2_write_ctl_busy.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_l2_write_ctl_busy);
 	as->arcstat_l2_free_on_write.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_l2_free_on_write);
 	as->arcstat_l2_abort_lowmem.value.ui64 =
@@ -7542,6 +8027,10 @@ arc_kstat_update(kstat_t *ksp, int rw)
 	    wmsum_value(&arc_sums.arcstat_raw_size);
 	as->arcstat_cached_only_in_progress.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_cached_only_in_progress);
+	as->arcstat_admission_accepted.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_admission_accepted);
+	as->arcstat_admission_rejected.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_admission_rejected);
 	as->arcstat_abd_chunk_waste_size.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_abd_chunk_waste_size);
 
@@ -7580,8 +8069,17 @@ arc_state_multilist_index_func(multilist_t *ml, void *obj)
 	 * would not be evenly distributed. In this context full 64bit
 	 * division would be a waste of time, so limit it to 32 bits.
 	 */
-	return ((unsigned int)buf_hash(hdr->b_spa, &hdr->b_dva, hdr->b_birth) %
-	    multilist_get_num_sublists(ml));
+	unsigned int hash = (unsigned int)buf_hash(hdr->b_spa, &hdr->b_dva,
+	    hdr->b_birth);
+	unsigned int first, count;
+
+	/*
+	 * With NUMA-aware eviction each node has a range of sublists of its
+	 * own, and the hash only picks one within that range.
+	 */
+	arc_node_sublists(multilist_get_num_sublists(ml), hdr->b_l1hdr.b_node,
+	    &first, &count);
+	return (first + hash % count);
 }
 
 static unsigned int
@@ -7677,6 +8175,94 @@ arc_state_multilist_init(multilist_t *ml,
 	*maxcountp = MAX(*maxcountp, multilist_get_num_sublists(ml));
 }
 
+static void
+arc_numa_init(void)
+{
+	arc_numa_nodes = 1;
+	if (zfs_arc_evict_numa && max_nnodes > 1)
+		arc_numa_nodes = MIN(max_nnodes, UINT8_MAX + 1);
+	if (arc_numa_nodes == 1)
+		return;
+
+	arc_node_size = kmem_alloc(arc_numa_nodes * sizeof (wmsum_t),
+	    KM_SLEEP);
+	for (int i = 0; i < arc_numa_nodes; i++)
+		wmsum_init(&arc_node_size[i], 0);
+	arc_node_share = kmem_zalloc(arc_numa_nodes * sizeof (uint32_t),
+	    KM_SLEEP);
+}
+
+static void
+arc_numa_fini(void)
+{
+	if (arc_numa_nodes == 1)
+		return;
+
+	for (int i = 0; i < arc_numa_nodes; i++)
+		wmsum_fini(&arc_node_size[i]);
+	kmem_free(arc_node_size, arc_numa_nodes * sizeof (wmsum_t));
+	arc_node_size = NULL;
+	kmem_free(arc_node_share, arc_numa_nodes * sizeof (uint32_t));
+	arc_node_share = NULL;
+	arc_numa_nodes = 1;
+}
+
+/*
+ * Called from the arc_reap thread about once a second to recompute the
+ * share of each NUMA node in the ARC data buffers, so that the shrinker
+ * does not have to sum every node's wmsum_t on each call.
+ */
+static void
+arc_numa_update(void)
+{
+	uint64_t total = 0;
+
+	if (arc_numa_nodes == 1)
+		return;
+
+	/*
+	 * The per-CPU parts of a node's size are read while they change, so
+	 * the sum can transiently be negative.
+	 */
+	for (int i = 0; i < arc_numa_nodes; i++)
+		total += MAX((int64_t)wmsum_value(&arc_node_size[i]), 0);
+
+	/* Scale down very large sizes so that size << 16 can't overflow. */
+	int shift = MAX(highbit64(total), 47) - 47;
+	for (int i = 0; i < arc_numa_nodes; i++) {
+		uint64_t size = MAX((int64_t)wmsum_value(&arc_node_size[i]), 0);
+
+		arc_node_share[i] = total == 0 ? 0 :
+		    MIN(((size >> shift) << 16) / (total >> shift), 1 << 16);
+	}
+}
+
+/*
+ * Returns the part of `pages' that corresponds to the share of the ARC data
+ * buffers on NUMA node `node'.
+ */
+uint64_t
+arc_numa_node_share(int node, uint64_t pages)
+{
+	if (arc_numa_nodes == 1)
+		return (pages);
+	if (node < 0 || node >= arc_numa_nodes)
+		return (0);
+
+	return ((pages * arc_node_share[node]) >> 16);
+}
+
+/*
+ * Tells the evict zthr that NUMA node `node' is short of memory, so that
+ * its next pass evicts from that node first.
+ */
+void
+arc_numa_evict_node(int node)
+{
+	if (arc_numa_nodes > 1 && node >= 0 && node < arc_numa_nodes)
+		(void) atomic_swap_32(&arc_evict_node_hint, node + 1);
+}
+
 static void
 arc_state_init(void)
 {
@@ -7779,6 +8365,8 @@ arc_state_init(void)
 	wmsum_init(&arc_sums.arcstat_access_skip, 0);
 	wmsum_init(&arc_sums.arcstat_evict_skip, 0);
 	wmsum_init(&arc_sums.arcstat_evict_not_enough, 0);
+	wmsum_init(&arc_sums.arcstat_evict_cost_skip, 0);
+	wmsum_init(&arc_sums.arcstat_evict_numa_local, 0);
 	wmsum_init(&arc_sums.arcstat_evict_l2_cached, 0);
 	wmsum_init(&arc_sums.arcstat_evict_l2_eligible, 0);
 	wmsum_init(&arc_sums.arcstat_evict_l2_eligible_mfu, 0);
@@ -7788,6 +8376,8 @@ arc_state_init(void)
 	wmsum_init(&arc_sums.arcstat_hash_elements, 0);
 	wmsum_init(&arc_sums.arcstat_hash_collisions, 0);
 	wmsum_init(&arc_sums.arcstat_hash_chains, 0);
+	wmsum_init(&arc_sums.arcstat_hash_lookup_lockless, 0);
+	wmsum_init(&arc_sums.arcstat_hash_lookup_locked, 0);
 	aggsum_init(&arc_sums.arcstat_size, 0);
 	wmsum_init(&arc_sums.arcstat_compressed_size, 0);
 	wmsum_init(&arc_sums.arcstat_uncompressed_size, 0);
@@ -7816,6 +8406,13 @@ arc_state_init(void)
 	wmsum_init(&arc_sums.arcstat_l2_evict_lock_retry, 0);
 	wmsum_init(&arc_sums.arcstat_l2_evict_reading, 0);
 	wmsum_init(&arc_sums.arcstat_l2_evict_l1cached, 0);
+	wmsum_init(&arc_sums.arcstat_l2_evict_bytes, 0);
+	wmsum_init(&arc_sums.arcstat_l2_retain_bytes, 0);
+	wmsum_init(&arc_sums.arcstat_l2_retain_bufs, 0);
+	wmsum_init(&arc_sums.arcstat_l2_write_ctl_rate, 0);
+	wmsum_init(&arc_sums.arcstat_l2_write_ctl_hit_rate, 0);
+	wmsum_init(&arc_sums.arcstat_l2_write_ctl_latency, 0);
+	wmsum_init(&arc_sums.arcstat_l2_write_ctl_busy, 0);
 	wmsum_init(&arc_sums.arcstat_l2_free_on_write, 0);
 	wmsum_init(&arc_sums.arcstat_l2_abort_lowmem, 0);
 	wmsum_init(&arc_sums.arcstat_l2_cksum_bad, 0);
@@ -7851,6 +8448,8 @@ arc_state_init(void)
 	wmsum_init(&arc_sums.arcstat_demand_iohit_prescient_prefetch, 0);
 	wmsum_init(&arc_sums.arcstat_raw_size, 0);
 	wmsum_init(&arc_sums.arcstat_cached_only_in_progress, 0);
+	wmsum_init(&arc_sums.arcstat_admission_accepted, 0);
+	wmsum_init(&arc_sums.arcstat_admission_rejected, 0);
 	wmsum_init(&arc_sums.arcstat_abd_chunk_waste_size, 0);
 
 	arc_anon->arcs_state = ARC_STATE_ANON;
@@ -7938,6 +8537,8 @@ arc_state_fini(void)
 	wmsum_fini(&arc_sums.arcstat_access_skip);
 	wmsum_fini(&arc_sums.arcstat_evict_skip);
 	wmsum_fini(&arc_sums.arcstat_evict_not_enough);
+	wmsum_fini(&arc_sums.arcstat_evict_cost_skip);
+	wmsum_fini(&arc_sums.arcstat_evict_numa_local);
 	wmsum_fini(&arc_sums.arcstat_evict_l2_cached);
 	wmsum_fini(&arc_sums.arcstat_evict_l2_eligible);
 	wmsum_fini(&arc_sums.arcstat_evict_l2_eligible_mfu);
@@ -7947,6 +8548,8 @@ arc_state_fini(void)
 	wmsum_fini(&arc_sums.arcstat_hash_elements);
 	wmsum_fini(&arc_sums.arcstat_hash_collisions);
 	wmsum_fini(&arc_sums.arcstat_hash_chains);
+	wmsum_fini(&arc_sums.arcstat_hash_lookup_lockless);
+	wmsum_fini(&arc_sums.arcstat_hash_lookup_locked);
 	aggsum_fini(&arc_sums.arcstat_size);
 	wmsum_fini(&arc_sums.arcstat_compressed_size);
 	wmsum_fini(&arc_sums.arcstat_uncompressed_size);
@@ -7975,6 +8578,13 @@ arc_state_fini(void)
 	wmsum_fini(&arc_sums.arcstat_l2_evict_lock_retry);
 	wmsum_fini(&arc_sums.arcstat_l2_evict_reading);
 	wmsum_fini(&arc_sums.arcstat_l2_evict_l1cached);
+	wmsum_fini(&arc_sums.arcstat_l2_evict_bytes);
+	wmsum_fini(&arc_sums.arcstat_l2_retain_bytes);
+	wmsum_fini(&arc_sums.arcstat_l2_retain_bufs);
+	wmsum_fini(&arc_sums.arcstat_l2_write_ctl_rate);
+	wmsum_fini(&arc_sums.arcstat_l2_write_ctl_hit_rate);
+	wmsum_fini(&arc_sums.arcstat_l2_write_ctl_latency);
+	wmsum_fini(&arc_sums.arcstat_l2_write_ctl_busy);
 	wmsum_fini(&arc_sums.arcstat_l2_free_on_write);
 	wmsum_fini(&arc_sums.arcstat_l2_abort_lowmem);
 	wmsum_fini(&arc_sums.arcstat_l2_cksum_bad);
@@ -8010,6 +8620,8 @@ arc_state_fini(void)
 	wmsum_fini(&arc_sums.arcstat_demand_iohit_prescient_prefetch);
 	wmsum_fini(&arc_sums.arcstat_raw_size);
 	wmsum_fini(&arc_sums.arcstat_cached_only_in_progress);
+	wmsum_fini(&arc_sums.arcstat_admission_accepted);
+	wmsum_fini(&arc_sums.arcstat_admission_rejected);
 	wmsum_fini(&arc_sums.arcstat_abd_chunk_waste_size);
 }
 
@@ -8053,6 +8665,7 @@ arc_init(void)
 	arc_min_prefetch = MSEC_TO_TICK(1000);
 	arc_min_prescient_prefetch = MSEC_TO_TICK(6000);
 
+	arc_numa_init();
 #if defined(_KERNEL)
 	arc_lowmem_init();
 #endif
@@ -8253,6 +8866,7 @@ arc_fini(void)
 	 */
 	buf_fini();
 	arc_state_fini();
+	arc_numa_fini();
 
 	arc_unregister_hotplug();
 
@@ -8267,6 +8881,305 @@ arc_fini(void)
 	ASSERT0(arc_loaned_bytes);
 }
 
+/*
+ * Persistent ARC warm-start
+ *
+ * When zfs_arc_warm_enabled is set, demand hits on MFU buffers of a pool
+ * are remembered in a fixed size, direct mapped table hanging off the
+ * spa_t (spa_arc_warm).  A slot is picked by hashing the block's DVA, so
+ * the table keeps recently hot blocks without any list maintenance; the
+ * table lock is only tried, and a contended update is simply dropped.
+ *
+ * On export, and when the pool is unloaded at shutdown, the table is
+ * sorted by DVA and written to a MOS object referenced from the pool
+ * directory (DMU_POOL_ARC_WARM).  The next import starts a zthr which
+ * walks the saved list in LBA order and issues throttled prescient
+ * prefetches for each block, stopping early if the ARC fills up.
+ *
+ * Entries record the block's bookmark rather than a raw block pointer,
+ * because an ARC header does not carry the block's checksum.  The
+ * prefetch resolves the bookmark through the pool's current metadata,
+ * so every warm-up read is made with a live, checksummed block pointer
+ * and stale entries for freed or rewritten blocks are harmless.
+ * Encrypted datasets are skipped since their keys are unlikely to be
+ * loaded while the pool is being imported.
+ *
+ * Progress is reported in the arc_warm_* fields of the pool's iostats
+ * kstat.
+ */
+
+static inline uint64_t
+arc_warm_slot(spa_t *spa, const dva_t *dva)
+{
+	return (cityhash4(DVA_GET_VDEV(dva), DVA_GET_OFFSET(dva), 0, 0) %
+	    spa->spa_arc_warm_size);
+}
+
+static void
+arc_warm_note(spa_t *spa, const zbookmark_phys_t *zb, const blkptr_t *bp)
+{
+	arc_warm_phys_t *awp;
+	const dva_t *dva = BP_IDENTITY(bp);
+
+	if (zb == NULL || zb->zb_level < 0)
+		return;
+
+	awp = &spa->spa_arc_warm[arc_warm_slot(spa, dva)];
+	if (awp->awp_birth == BP_GET_PHYSICAL_BIRTH(bp) &&
+	    awp->awp_offset == DVA_GET_OFFSET(dva))
+		return;
+
+	if (!mutex_tryenter(&spa->spa_arc_warm_lock))
+		return;
+	awp->awp_objset = zb->zb_objset;
+	awp->awp_object = zb->zb_object;
+	awp->awp_level = zb->zb_level;
+	awp->awp_blkid = zb->zb_blkid;
+	awp->awp_vdev = DVA_GET_VDEV(dva);
+	awp->awp_offset = DVA_GET_OFFSET(dva);
+	awp->awp_birth = BP_GET_PHYSICAL_BIRTH(bp);
+	mutex_exit(&spa->spa_arc_warm_lock);
+}
+
+static int
+arc_warm_compare(const void *x1, const void *x2)
+{
+	const arc_warm_phys_t *a1 = x1;
+	const arc_warm_phys_t *a2 = x2;
+
+	int cmp = TREE_CMP(a1->awp_vdev, a2->awp_vdev);
+	if (likely(cmp))
+		return (cmp);
+
+	return (TREE_CMP(a1->awp_offset, a2->awp_offset));
+}
+
+typedef struct arc_warm_save_arg {
+	arc_warm_phys_t	*awsa_list;
+	uint64_t	awsa_count;
+} arc_warm_save_arg_t;
+
+/*
+ * Replace the saved list, if any, with the one in arg.  The new object is
+ * written before the directory entry is switched to it, and only then is
+ * the old one freed.  An empty list just removes the saved one, which is
+ * also how a replayed list is retired.
+ */
+static void
+arc_warm_save_sync(void *arg, dmu_tx_t *tx)
+{
+	arc_warm_save_arg_t *awsa = arg;
+	objset_t *mos = dmu_tx_pool(tx)->dp_meta_objset;
+	uint64_t old[2], ent[2];
+	boolean_t exists;
+
+	exists = zap_lookup(mos, DMU_POOL_DIRECTORY_OBJECT, DMU_POOL_ARC_WARM,
+	    sizeof (uint64_t), 2, old) == 0;
+
+	if (awsa->awsa_count != 0) {
+		ent[0] = dmu_object_alloc(mos, DMU_OTN_UINT64_METADATA,
+		    SPA_OLD_MAXBLOCKSIZE, DMU_OT_NONE, 0, tx);
+		ent[1] = awsa->awsa_count;
+		dmu_write(mos, ent[0], 0,
+		    awsa->awsa_count * sizeof (arc_warm_phys_t),
+		    awsa->awsa_list, tx, DMU_READ_NO_PREFETCH);
+		VERIFY0(zap_update(mos, DMU_POOL_DIRECTORY_OBJECT,
+		    DMU_POOL_ARC_WARM, sizeof (uint64_t), 2, ent, tx));
+	} else if (exists) {
+		VERIFY0(zap_remove(mos, DMU_POOL_DIRECTORY_OBJECT,
+		    DMU_POOL_ARC_WARM, tx));
+	}
+
+	if (exists)
+		VERIFY0(dmu_object_free(mos, old[0], tx));
+}
+
+/*
+ * Write the hot block table of a pool that is about to be unloaded.
+ */
+void
+arc_warm_save(spa_t *spa)
+{
+	arc_warm_save_arg_t awsa;
+	dsl_pool_t *dp = spa_get_dsl(spa);
+
+	if (spa->spa_arc_warm == NULL)
+		return;
+
+	if (spa->spa_arc_warm_zthr != NULL)
+		zthr_cancel(spa->spa_arc_warm_zthr);
+
+	awsa.awsa_list = vmem_alloc(spa->spa_arc_warm_size *
+	    sizeof (arc_warm_phys_t), KM_SLEEP);
+	awsa.awsa_count = 0;
+	mutex_enter(&spa->spa_arc_warm_lock);
+	for (uint64_t i = 0; i < spa->spa_arc_warm_size; i++) {
+		if (spa->spa_arc_warm[i].awp_birth != 0)
+			awsa.awsa_list[awsa.awsa_count++] = spa->spa_arc_warm[i];
+	}
+	mutex_exit(&spa->spa_arc_warm_lock);
+	qsort(awsa.awsa_list, awsa.awsa_count, sizeof (arc_warm_phys_t),
+	    arc_warm_compare);
+
+	dmu_tx_t *tx = dmu_tx_create_dd(dp->dp_mos_dir);
+	VERIFY0(dmu_tx_assign(tx, DMU_TX_WAIT));
+	uint64_t txg = dmu_tx_get_txg(tx);
+	dsl_sync_task_nowait(dp, arc_warm_save_sync, &awsa, tx);
+	dmu_tx_commit(tx);
+	txg_wait_synced(dp, txg);
+
+	vmem_free(awsa.awsa_list, spa->spa_arc_warm_size *
+	    sizeof (arc_warm_phys_t));
+}
+
+/*
+ * Issue a prefetch for one saved block.  Returns 0 if a read was
+ * attempted through the block's current block pointer.
+ */
+static int
+arc_warm_prefetch(spa_t *spa, const arc_warm_phys_t *awp)
+{
+	dsl_pool_t *dp = spa_get_dsl(spa);
+	dsl_dataset_t *ds = NULL;
+	objset_t *os = NULL;
+	dnode_t *dn;
+	int err = 0;
+
+	if (awp->awp_level < 0 || awp->awp_birth == 0)
+		return (SET_ERROR(EINVAL));
+
+	dsl_pool_config_enter(dp, FTAG);
+	if (awp->awp_objset == DMU_META_OBJSET) {
+		os = spa_meta_objset(spa);
+	} else {
+		err = dsl_dataset_hold_obj(dp, awp->awp_objset, FTAG, &ds);
+		if (err == 0 && ds->ds_dir->dd_crypto_obj != 0)
+			err = SET_ERROR(EACCES);
+		if (err == 0)
+			err = dmu_objset_from_ds(ds, &os);
+	}
+	if (err == 0)
+		err = dnode_hold(os, awp->awp_object, FTAG, &dn);
+	if (err == 0) {
+		rw_enter(&dn->dn_struct_rwlock, RW_READER);
+		(void) dbuf_prefetch(dn, awp->awp_level, awp->awp_blkid,
+		    ZIO_PRIORITY_ASYNC_READ, ARC_FLAG_PRESCIENT_PREFETCH);
+		rw_exit(&dn->dn_struct_rwlock);
+		dnode_rele(dn, FTAG);
+	}
+	if (ds != NULL)
+		dsl_dataset_rele(ds, FTAG);
+	dsl_pool_config_exit(dp, FTAG);
+
+	return (err);
+}
+
+static boolean_t
+arc_warm_cb_check(void *arg, zthr_t *zthr)
+{
+	(void) zthr;
+	spa_t *spa = arg;
+
+	return (spa->spa_arc_warm_pending);
+}
+
+static void
+arc_warm_cb(void *arg, zthr_t *zthr)
+{
+	spa_t *spa = arg;
+	objset_t *mos = spa_meta_objset(spa);
+	arc_warm_phys_t *list = NULL;
+	uint64_t ent[2], issued = 0, skipped = 0, size = 0;
+	uint_t batch = 0;
+
+	spa->spa_arc_warm_pending = B_FALSE;
+
+	if (zap_lookup(mos, DMU_POOL_DIRECTORY_OBJECT, DMU_POOL_ARC_WARM,
+	    sizeof (uint64_t), 2, ent) != 0)
+		return;
+
+	ent[1] = MIN(ent[1], MAX(zfs_arc_warm_max_blocks, 1));
+	size = ent[1] * sizeof (arc_warm_phys_t);
+	list = vmem_alloc(size, KM_SLEEP);
+	if (dmu_read(mos, ent[0], 0, size, list, DMU_READ_PREFETCH) != 0) {
+		vmem_free(list, size);
+		return;
+	}
+	spa_iostats_arc_warm_add(spa, ent[1], 0, 0);
+
+	for (uint64_t i = 0; i < ent[1] && !zthr_iscancelled(zthr); i++) {
+		/*
+		 * Warming up is only useful while it does not displace
+		 * blocks the workload has already brought in.
+		 */
+		if (aggsum_upper_bound(&arc_sums.arcstat_size) >= arc_c)
+			break;
+
+		if (arc_warm_prefetch(spa, &list[i]) == 0)
+			issued++;
+		else
+			skipped++;
+
+		if (++batch >= MAX(zfs_arc_warm_rate / 10, 1)) {
+			spa_iostats_arc_warm_add(spa, 0, issued, skipped);
+			issued = skipped = batch = 0;
+			delay(MAX(hz / 10, 1));
+		}
+	}
+	spa_iostats_arc_warm_add(spa, 0, issued, skipped);
+
+	vmem_free(list, size);
+
+	/*
+	 * The list has served its purpose, so don't replay it on every
+	 * later import, e.g. if the pool is next exported with warm-start
+	 * disabled.  When cancelled by an export, arc_warm_save() replaces
+	 * it instead.
+	 */
+	if (!zthr_iscancelled(zthr)) {
+		arc_warm_save_arg_t awsa = { NULL, 0 };
+		(void) dsl_sync_task(spa_name(spa), NULL, arc_warm_save_sync,
+		    &awsa, 0, ZFS_SPACE_CHECK_EXTRA_RESERVED);
+	}
+}
+
+/*
+ * Called once a writeable pool has been loaded or created.  Sets up the
+ * hot block table and starts warming up the ARC from the list saved by
+ * the previous export, if there is one.
+ */
+void
+arc_warm_start(spa_t *spa)
+{
+	ASSERT0P(spa->spa_arc_warm);
+	ASSERT0P(spa->spa_arc_warm_zthr);
+
+	if (!zfs_arc_warm_enabled || zfs_arc_warm_max_blocks == 0)
+		return;
+
+	spa->spa_arc_warm_size = zfs_arc_warm_max_blocks;
+	spa->spa_arc_warm = vmem_zalloc(spa->spa_arc_warm_size *
+	    sizeof (arc_warm_phys_t), KM_SLEEP);
+	spa->spa_arc_warm_pending = zap_contains(spa_meta_objset(spa),
+	    DMU_POOL_DIRECTORY_OBJECT, DMU_POOL_ARC_WARM) == 0;
+	spa->spa_arc_warm_zthr = zthr_create("z_arc_warm",
+	    arc_warm_cb_check, arc_warm_cb, spa, minclsyspri);
+}
+
+void
+arc_warm_fini(spa_t *spa)
+{
+	ASSERT0P(spa->spa_arc_warm_zthr);
+
+	if (spa->spa_arc_warm == NULL)
+		return;
+
+	vmem_free(spa->spa_arc_warm, spa->spa_arc_warm_size *
+	    sizeof (arc_warm_phys_t));
+	spa->spa_arc_warm = NULL;
+	spa->spa_arc_warm_size = 0;
+}
+
 /*
  * Level 2 ARC
  *
@@ -8390,6 +9303,7 @@ arc_fini(void)
  *
  *	l2arc_write_max		max write bytes per interval
  *	l2arc_dwpd_limit	device write endurance limit (100 = 1.0 DWPD)
+ *	l2arc_write_adaptive	steer the write rate by the hits it buys
  *	l2arc_noprefetch	skip caching prefetched buffers
  *	l2arc_headroom		number of max device writes to precache
  *	l2arc_headroom_boost	when we find compressed buffers during ARC
@@ -8562,6 +9476,8 @@ l2arc_write_size(l2arc_dev_t *dev, clock_t *interval)
 
 	size = P2ROUNDUP(size, 1ULL << dev->l2ad_vdev->vdev_ashift);
 
+	dev->l2ad_wctl_interval = SEC2NSEC(*interval) / hz;
+
 	return (size);
 
 }
@@ -8664,11 +9580,21 @@ top:
 		}
 
 		/*
-		 * We could not have been moved into the arc_l2c_only
-		 * state while in-flight due to our ARC_FLAG_L2_WRITING
-		 * bit being set. Let's just ensure that's being enforced.
+		 * ARC buffers could not have been moved into the
+		 * arc_l2c_only state while in-flight due to our
+		 * ARC_FLAG_L2_WRITING bit being set.  Only headers
+		 * created by l2arc_write_retained() may be L2-only here,
+		 * and there is nothing left of them if the write failed.
 		 */
-		ASSERT(HDR_HAS_L1HDR(hdr));
+		if (!HDR_HAS_L1HDR(hdr)) {
+			arc_hdr_clear_flags(hdr, ARC_FLAG_L2_WRITING);
+			if (zio->io_error != 0) {
+				arc_change_state(arc_anon, hdr);
+				arc_hdr_destroy(hdr);
+			}
+			mutex_exit(hash_lock);
+			continue;
+		}
 
 		/*
 		 * Skipped - drop L2ARC entry and mark the header as no
@@ -8764,6 +9690,11 @@ top:
 		}
 	}
 
+	if (zio->io_error == 0) {
+		l2arc_write_ctl_update(dev, gethrtime() - cb->l2wcb_start,
+		    cb->l2wcb_asize);
+	}
+
 	ARCSTAT_BUMP(arcstat_l2_writes_done);
 	list_remove(buflist, head);
 	ASSERT(!HDR_HAS_L1HDR(head));
@@ -9231,6 +10162,139 @@ l2arc_dwpd_rate_limit(l2arc_dev_t *dev)
 	return ((total_budget - dev->l2ad_dwpd_writes) / remaining_secs);
 }
 
+/*
+ * Drops the adaptive write throttle state of a device, when the throttle
+ * is turned off or the device is being removed.
+ */
+static void
+l2arc_write_ctl_reset(l2arc_dev_t *dev)
+{
+	ARCSTAT_INCR(arcstat_l2_write_ctl_rate, -dev->l2ad_wctl_rate);
+	ARCSTAT_INCR(arcstat_l2_write_ctl_hit_rate, -dev->l2ad_wctl_hit_rate);
+	ARCSTAT_INCR(arcstat_l2_write_ctl_latency, -dev->l2ad_wctl_lat);
+
+	dev->l2ad_wctl_rate = 0;
+	dev->l2ad_wctl_dir = -1;
+	dev->l2ad_wctl_lat = 0;
+	dev->l2ad_wctl_epoch = 0;
+	dev->l2ad_wctl_written = 0;
+	dev->l2ad_wctl_hit_rate = 0;
+	dev->l2ad_wctl_write_rate = 0;
+	dev->l2ad_wctl_hits_start = wmsum_value(&dev->l2ad_wctl_hits);
+}
+
+/*
+ * Returns the write rate the adaptive throttle allows for the device,
+ * which is at most write_max.  The throttle starts out at write_max and
+ * first probes downwards: until the L2ARC has been filled every write
+ * is useful, so it is not used during the first sweep.
+ */
+static uint64_t
+l2arc_write_ctl_rate(l2arc_dev_t *dev, uint64_t write_max)
+{
+	uint64_t min_rate = MAX(write_max >> L2ARC_WCTL_MIN_SHIFT, 1);
+	uint64_t rate;
+
+	if (!l2arc_write_adaptive || dev->l2ad_first) {
+		if (dev->l2ad_wctl_rate != 0)
+			l2arc_write_ctl_reset(dev);
+		return (write_max);
+	}
+
+	if (dev->l2ad_wctl_rate == 0) {
+		dev->l2ad_wctl_epoch = gethrtime();
+		dev->l2ad_wctl_written = 0;
+		dev->l2ad_wctl_hits_start = wmsum_value(&dev->l2ad_wctl_hits);
+		rate = write_max;
+	} else {
+		/* l2arc_write_max may have changed since the last update. */
+		rate = MIN(MAX(dev->l2ad_wctl_rate, min_rate), write_max);
+	}
+	ARCSTAT_INCR(arcstat_l2_write_ctl_rate, rate - dev->l2ad_wctl_rate);
+	dev->l2ad_wctl_rate = rate;
+
+	return (rate);
+}
+
+/*
+ * Feeds the adaptive write throttle with the latency and size of the
+ * writes that just completed, and once per L2ARC_WCTL_PERIOD moves the
+ * device's write rate one step towards more hits per byte written.
+ * Called from l2arc_write_done(); the feed thread is waiting for it, so
+ * it cannot race with l2arc_write_ctl_rate().
+ */
+static void
+l2arc_write_ctl_update(l2arc_dev_t *dev, hrtime_t lat, uint64_t asize)
+{
+	uint64_t rate = dev->l2ad_wctl_rate;
+	hrtime_t now = gethrtime();
+	hrtime_t elapsed, old_lat;
+
+	if (rate == 0)
+		return;
+
+	old_lat = dev->l2ad_wctl_lat;
+	if (old_lat == 0)
+		dev->l2ad_wctl_lat = lat;
+	else
+		dev->l2ad_wctl_lat = old_lat - old_lat / 8 + lat / 8;
+	ARCSTAT_INCR(arcstat_l2_write_ctl_latency,
+	    dev->l2ad_wctl_lat - old_lat);
+
+	dev->l2ad_wctl_written += asize;
+	elapsed = now - dev->l2ad_wctl_epoch;
+	if (elapsed < SEC2NSEC(L2ARC_WCTL_PERIOD))
+		return;
+
+	uint64_t secs = MAX(NSEC2SEC(elapsed), 1);
+	uint64_t hits = wmsum_value(&dev->l2ad_wctl_hits);
+	uint64_t hit_rate = (hits - dev->l2ad_wctl_hits_start) / secs;
+	uint64_t write_rate = dev->l2ad_wctl_written / secs;
+	uint64_t write_max = MAX(l2arc_write_max, 1);
+	uint64_t min_rate = MAX(write_max >> L2ARC_WCTL_MIN_SHIFT, 1);
+
+	if (l2arc_write_busy_pct != 0 && dev->l2ad_wctl_lat >
+	    dev->l2ad_wctl_interval * l2arc_write_busy_pct / 100) {
+		/* The device cannot keep up, back off quickly. */
+		ARCSTAT_BUMP(arcstat_l2_write_ctl_busy);
+		dev->l2ad_wctl_dir = -1;
+		rate /= 2;
+	} else if (write_rate >= rate / 2) {
+		/*
+		 * The throttle is what limits the writes.  Compare the
+		 * hits gained (or lost) with the bytes written since the
+		 * last step, and keep writing more only while that pays.
+		 */
+		int64_t dw = (int64_t)write_rate -
+		    (int64_t)dev->l2ad_wctl_write_rate;
+		int64_t dh = (int64_t)hit_rate -
+		    (int64_t)dev->l2ad_wctl_hit_rate;
+
+		if (dw >= (int64_t)rate / 32) {
+			dev->l2ad_wctl_dir = (dh * 100 >=
+			    dw * (int64_t)l2arc_write_gain_pct) ? 1 : -1;
+		} else if (-dw >= (int64_t)rate / 32) {
+			dev->l2ad_wctl_dir = (dh * 100 <=
+			    dw * (int64_t)l2arc_write_gain_pct) ? 1 : -1;
+		}
+		if (dev->l2ad_wctl_dir > 0)
+			rate += rate / 8;
+		else
+			rate -= rate / 8;
+	}
+	rate = MIN(MAX(rate, min_rate), write_max);
+
+	ARCSTAT_INCR(arcstat_l2_write_ctl_rate, rate - dev->l2ad_wctl_rate);
+	ARCSTAT_INCR(arcstat_l2_write_ctl_hit_rate,
+	    hit_rate - dev->l2ad_wctl_hit_rate);
+	dev->l2ad_wctl_rate = rate;
+	dev->l2ad_wctl_hit_rate = hit_rate;
+	dev->l2ad_wctl_write_rate = write_rate;
+	dev->l2ad_wctl_written = 0;
+	dev->l2ad_wctl_hits_start = hits;
+	dev->l2ad_wctl_epoch = now;
+}
+
 /*
  * Get write rate based on device state and DWPD configuration.
  */
@@ -9249,6 +10313,8 @@ l2arc_get_write_rate(l2arc_dev_t *dev)
 		write_max = l2arc_write_max = L2ARC_WRITE_SIZE;
 	}
 
+	write_max = l2arc_write_ctl_rate(dev, write_max);
+
 	/* Apply DWPD rate limit for persistent marker configurations */
 	if (!dev->l2ad_first && l2arc_dwpd_limit > 0 &&
 	    spa->spa_l2arc_info.l2arc_total_capacity >=
@@ -9260,6 +10326,69 @@ l2arc_get_write_rate(l2arc_dev_t *dev)
 	return (write_max);
 }
 
+/*
+ * Queues a hot L2-only header that is about to be evicted so that its
+ * buffer can be written again at the write hand.  The header itself is
+ * still evicted; l2arc_write_retained() creates a new one once the data
+ * has been rewritten.  Returns B_FALSE if the buffer cannot be retained.
+ */
+static boolean_t
+l2arc_retain_hdr(l2arc_dev_t *dev, const arc_buf_hdr_t *hdr)
+{
+	l2arc_retain_buf_t *lr;
+
+	ASSERT(MUTEX_HELD(&dev->l2ad_mtx));
+	ASSERT(MUTEX_HELD(HDR_LOCK(hdr)));
+	ASSERT(!HDR_HAS_L1HDR(hdr));
+
+	lr = kmem_alloc(sizeof (*lr), KM_NOSLEEP);
+	if (lr == NULL)
+		return (B_FALSE);
+
+	l2arc_hdr_to_log_ent(hdr, &lr->lr_le);
+	lr->lr_abd = NULL;
+	lr->lr_error = 0;
+	list_insert_tail(&dev->l2ad_retain_list, lr);
+
+	return (B_TRUE);
+}
+
+static void
+l2arc_retain_read_done(zio_t *zio)
+{
+	l2arc_retain_buf_t *lr = zio->io_private;
+
+	lr->lr_error = zio->io_error;
+}
+
+/*
+ * Reads the buffers queued by l2arc_retain_hdr() from their old location.
+ * The data is read exactly as stored on the device; it is not verified
+ * here, but every L2ARC hit is checked against the block pointer of the
+ * reader, so a bad copy only costs a fallback read from the pool.
+ */
+static void
+l2arc_retain_read(l2arc_dev_t *dev)
+{
+	zio_t *pio = zio_root(dev->l2ad_spa, NULL, NULL, ZIO_FLAG_CANFAIL);
+
+	for (l2arc_retain_buf_t *lr = list_head(&dev->l2ad_retain_list);
+	    lr != NULL; lr = list_next(&dev->l2ad_retain_list, lr)) {
+		uint64_t asize = vdev_psize_to_asize(dev->l2ad_vdev,
+		    L2BLK_GET_PSIZE(lr->lr_le.le_prop));
+
+		lr->lr_abd = abd_alloc_for_io(asize,
+		    L2BLK_GET_TYPE(lr->lr_le.le_prop) == ARC_BUFC_METADATA);
+		zio_nowait(zio_read_phys(pio, dev->l2ad_vdev,
+		    lr->lr_le.le_daddr, asize, lr->lr_abd, ZIO_CHECKSUM_OFF,
+		    l2arc_retain_read_done, lr, ZIO_PRIORITY_ASYNC_READ,
+		    ZIO_FLAG_CANFAIL | ZIO_FLAG_DONT_PROPAGATE |
+		    ZIO_FLAG_DONT_RETRY, B_FALSE));
+	}
+
+	(void) zio_wait(pio);
+}
+
 /*
  * Evict buffers from the device write hand to the distance specified in
  * bytes. This distance may span populated buffers, it may span nothing.
@@ -9276,12 +10405,16 @@ l2arc_evict(l2arc_dev_t *dev, uint64_t distance, boolean_t all)
 	l2arc_lb_ptr_buf_t *lb_ptr_buf, *lb_ptr_buf_prev;
 	vdev_t *vd = dev->l2ad_vdev;
 	boolean_t rerun;
+	uint64_t retain_budget = 0;
 
 	ASSERT(vd != NULL || all);
 	ASSERT(dev->l2ad_spa != NULL || all);
 
 	buflist = &dev->l2ad_buflist;
 
+	if (!all && l2arc_retain_hits != 0 && l2arc_trim_ahead == 0)
+		retain_budget = distance * MIN(l2arc_retain_pct, 100) / 100;
+
 top:
 	rerun = B_FALSE;
 	if (dev->l2ad_hand + distance > dev->l2ad_end) {
@@ -9428,6 +10561,15 @@ retry:
 			break;
 		}
 
+		uint64_t asize = HDR_GET_L2SIZE(hdr);
+		if (!HDR_HAS_L1HDR(hdr) && asize <= retain_budget &&
+		    hdr->b_l2hdr.b_hits >= l2arc_retain_hits &&
+		    l2arc_retain_hdr(dev, hdr)) {
+			retain_budget -= asize;
+		} else if (!all) {
+			ARCSTAT_INCR(arcstat_l2_evict_bytes, asize);
+		}
+
 		if (!HDR_HAS_L1HDR(hdr)) {
 			ASSERT(!HDR_L2_READING(hdr));
 			/*
@@ -9480,6 +10622,13 @@ out:
 		goto top;
 	}
 
+	/*
+	 * Read back the retained buffers before l2arc_write_buffers()
+	 * starts overwriting the region they were evicted from.
+	 */
+	if (!list_is_empty(&dev->l2ad_retain_list))
+		l2arc_retain_read(dev);
+
 	if (!all) {
 		/*
 		 * In case of cache device removal (all) the following
@@ -9801,6 +10950,8 @@ skip:
 			    KM_SLEEP);
 			(*cb)->l2wcb_dev = dev;
 			(*cb)->l2wcb_head = head;
+			(*cb)->l2wcb_start = gethrtime();
+			(*cb)->l2wcb_asize = 0;
 			list_create(&(*cb)->l2wcb_abd_list,
 			    sizeof (l2arc_lb_abd_buf_t),
 			    offsetof(l2arc_lb_abd_buf_t, node));
@@ -9935,6 +11086,106 @@ l2arc_reset_all_markers(spa_t *spa)
 	spa->spa_l2arc_info.l2arc_total_writes = 0;
 }
 
+/*
+ * Writes the buffers read back by l2arc_retain_read() at the write hand
+ * and re-creates their L2-only headers.  The headers are marked as being
+ * written, so they are not read from the device before the write is done;
+ * l2arc_write_done() destroys them if the write fails.  Buffers which do
+ * not fit in this write, or which are in the ARC again, are dropped.
+ */
+static void
+l2arc_write_retained(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz,
+    uint64_t *write_asize, uint64_t *write_psize, zio_t **pio,
+    l2arc_write_callback_t **cb, arc_buf_hdr_t *head)
+{
+	l2arc_retain_buf_t *lr;
+
+	while ((lr = list_remove_head(&dev->l2ad_retain_list)) != NULL) {
+		const l2arc_log_ent_phys_t *le = &lr->lr_le;
+		uint64_t psize = L2BLK_GET_PSIZE(le->le_prop);
+		uint64_t asize = vdev_psize_to_asize(dev->l2ad_vdev, psize);
+		arc_buf_hdr_t *hdr, *exists;
+		kmutex_t *hash_lock;
+
+		if (lr->lr_error != 0 || *write_asize + asize +
+		    sizeof (l2arc_log_blk_phys_t) > target_sz) {
+			ARCSTAT_INCR(arcstat_l2_evict_bytes, asize);
+			abd_free(lr->lr_abd);
+			kmem_free(lr, sizeof (*lr));
+			continue;
+		}
+
+		hdr = arc_buf_alloc_l2only(L2BLK_GET_LSIZE(le->le_prop),
+		    L2BLK_GET_TYPE(le->le_prop), dev, le->le_dva,
+		    dev->l2ad_hand, psize, asize, le->le_birth,
+		    L2BLK_GET_COMPRESS(le->le_prop), le->le_complevel,
+		    L2BLK_GET_PROTECTED(le->le_prop),
+		    L2BLK_GET_PREFETCH(le->le_prop),
+		    L2BLK_GET_STATE(le->le_prop));
+		hdr->b_l2hdr.b_hits = 0;
+		arc_hdr_set_flags(hdr, ARC_FLAG_L2_WRITING);
+
+		exists = buf_hash_insert(hdr, &hash_lock);
+		if (exists != NULL) {
+			/* The block was cached again since it was evicted. */
+			mutex_exit(hash_lock);
+			arc_hdr_clear_flags(hdr,
+			    ARC_FLAG_HAS_L2HDR | ARC_FLAG_L2_WRITING);
+			arc_hdr_destroy(hdr);
+			ARCSTAT_INCR(arcstat_l2_evict_bytes, asize);
+			abd_free(lr->lr_abd);
+			kmem_free(lr, sizeof (*lr));
+			continue;
+		}
+
+		(void) zfs_refcount_add_many(&dev->l2ad_alloc,
+		    arc_hdr_size(hdr), hdr);
+		l2arc_hdr_arcstats_increment(hdr);
+		vdev_space_update(dev->l2ad_vdev, asize, 0, 0);
+
+		mutex_enter(&dev->l2ad_mtx);
+		if (*pio == NULL)
+			list_insert_head(&dev->l2ad_buflist, head);
+		list_insert_head(&dev->l2ad_buflist, hdr);
+		mutex_exit(&dev->l2ad_mtx);
+
+		boolean_t commit = l2arc_log_blk_insert(dev, hdr);
+		mutex_exit(hash_lock);
+
+		if (*pio == NULL) {
+			*cb = kmem_alloc(sizeof (l2arc_write_callback_t),
+			    KM_SLEEP);
+			(*cb)->l2wcb_dev = dev;
+			(*cb)->l2wcb_head = head;
+			(*cb)->l2wcb_start = gethrtime();
+			(*cb)->l2wcb_asize = 0;
+			list_create(&(*cb)->l2wcb_abd_list,
+			    sizeof (l2arc_lb_abd_buf_t),
+			    offsetof(l2arc_lb_abd_buf_t, node));
+			*pio = zio_root(spa, l2arc_write_done, *cb,
+			    ZIO_FLAG_CANFAIL);
+		}
+
+		zio_nowait(zio_write_phys(*pio, dev->l2ad_vdev,
+		    dev->l2ad_hand, asize, lr->lr_abd, ZIO_CHECKSUM_OFF,
+		    NULL, NULL, ZIO_PRIORITY_ASYNC_WRITE,
+		    ZIO_FLAG_CANFAIL, B_FALSE));
+		l2arc_free_abd_on_write(lr->lr_abd, dev);
+		kmem_free(lr, sizeof (*lr));
+
+		ARCSTAT_BUMP(arcstat_l2_retain_bufs);
+		ARCSTAT_INCR(arcstat_l2_retain_bytes, asize);
+		*write_psize += psize;
+		*write_asize += asize;
+		dev->l2ad_hand += asize;
+
+		if (commit) {
+			/* l2ad_hand will be adjusted inside. */
+			*write_asize += l2arc_log_blk_commit(dev, *pio, *cb);
+		}
+	}
+}
+
 /*
  * Find and write ARC buffers to the L2ARC device.
  *
@@ -9986,6 +11237,14 @@ l2arc_write_buffers(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz)
 	}
 	mutex_exit(&spa->spa_l2arc_info.l2arc_sublist_lock);
 
+	/*
+	 * Hot buffers kept from the evicted region go first.
+	 */
+	if (!list_is_empty(&dev->l2ad_retain_list)) {
+		l2arc_write_retained(spa, dev, target_sz, &write_asize,
+		    &write_psize, &pio, &cb, head);
+	}
+
 	/*
 	 * Copy buffers for L2ARC writing.
 	 */
@@ -10148,6 +11407,7 @@ l2arc_write_buffers(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz)
 	ARCSTAT_INCR(arcstat_l2_write_bytes, write_psize);
 
 	dev->l2ad_writing = B_TRUE;
+	cb->l2wcb_asize = write_asize;
 	(void) zio_wait(pio);
 	dev->l2ad_writing = B_FALSE;
 
@@ -10412,7 +11672,8 @@ l2arc_update_smallest_capacity(spa_t *spa)
 
 /*
  * Add a vdev for use by the L2ARC.  By this point the spa has already
- * validated the vdev and opened it.
+ * validated the vdev and opened it.  Fails with ENOSPC if all 64K device
+ * ids are taken.
  */
 void
 l2arc_add_vdev(spa_t *spa, vdev_t *vd)
@@ -10443,6 +11704,8 @@ l2arc_add_vdev(spa_t *spa, vdev_t *vd)
 	adddev->l2ad_dwpd_start = gethrestime_sec();
 	adddev->l2ad_dwpd_accumulated = 0;
 	adddev->l2ad_dwpd_bump = l2arc_dwpd_bump;
+	adddev->l2ad_wctl_dir = -1;
+	wmsum_init(&adddev->l2ad_wctl_hits, 0);
 	list_link_init(&adddev->l2ad_node);
 	adddev->l2ad_dev_hdr = kmem_zalloc(l2dhdr_asize, KM_SLEEP);
 
@@ -10461,6 +11724,13 @@ l2arc_add_vdev(spa_t *spa, vdev_t *vd)
 	list_create(&adddev->l2ad_lbptr_list, sizeof (l2arc_lb_ptr_buf_t),
 	    offsetof(l2arc_lb_ptr_buf_t, node));
 
+	/*
+	 * Hot buffers being carried over from the evicted region to the
+	 * write hand, see l2arc_retain_hdr().
+	 */
+	list_create(&adddev->l2ad_retain_list, sizeof (l2arc_retain_buf_t),
+	    offsetof(l2arc_retain_buf_t, lr_node));
+
 	vdev_space_update(vd, 0, 0, adddev->l2ad_end - adddev->l2ad_hand);
 	zfs_refcount_create(&adddev->l2ad_alloc);
 
@@ -10578,12 +11848,16 @@ l2arc_device_teardown(void *arg)
 	list_destroy(&remdev->l2ad_buflist);
 	ASSERT(list_is_empty(&remdev->l2ad_lbptr_list));
 	list_destroy(&remdev->l2ad_lbptr_list);
+	ASSERT(list_is_empty(&remdev->l2ad_retain_list));
+	list_destroy(&remdev->l2ad_retain_list);
+	l2arc_write_ctl_reset(remdev);
 	mutex_destroy(&remdev->l2ad_mtx);
 	mutex_destroy(&remdev->l2ad_feed_thr_lock);
 	cv_destroy(&remdev->l2ad_feed_cv);
 	zfs_refcount_destroy(&remdev->l2ad_alloc);
 	zfs_refcount_destroy(&remdev->l2ad_lb_asize);
 	zfs_refcount_destroy(&remdev->l2ad_lb_count);
+	wmsum_fini(&remdev->l2ad_wctl_hits);
 	kmem_free(remdev->l2ad_dev_hdr, remdev->l2ad_dev_hdr_asize);
 	vmem_free(remdev, sizeof (l2arc_dev_t));
 
@@ -11604,6 +12878,28 @@ l2arc_log_blkptr_valid(l2arc_dev_t *dev, const l2arc_log_blkptr_t *lbp)
 	return (!evicted);
 }
 
+/*
+ * Fills in a log entry describing the L2ARC buffer of header `hdr'.
+ */
+static void
+l2arc_hdr_to_log_ent(const arc_buf_hdr_t *hdr, l2arc_log_ent_phys_t *le)
+{
+	ASSERT(HDR_HAS_L2HDR(hdr));
+
+	memset(le, 0, sizeof (*le));
+	le->le_dva = hdr->b_dva;
+	le->le_birth = hdr->b_birth;
+	le->le_daddr = hdr->b_l2hdr.b_daddr;
+	L2BLK_SET_LSIZE((le)->le_prop, HDR_GET_LSIZE(hdr));
+	L2BLK_SET_PSIZE((le)->le_prop, HDR_GET_PSIZE(hdr));
+	L2BLK_SET_COMPRESS((le)->le_prop, HDR_GET_COMPRESS(hdr));
+	le->le_complevel = hdr->b_complevel;
+	L2BLK_SET_TYPE((le)->le_prop, hdr->b_type);
+	L2BLK_SET_PROTECTED((le)->le_prop, !!(HDR_PROTECTED(hdr)));
+	L2BLK_SET_PREFETCH((le)->le_prop, !!(HDR_PREFETCH(hdr)));
+	L2BLK_SET_STATE((le)->le_prop, hdr->b_l2hdr.b_arcs_state);
+}
+
 /*
  * Inserts ARC buffer header `hdr' into the current L2ARC log block on
  * the device. The buffer being inserted must be present in L2ARC.
@@ -11625,20 +12921,9 @@ l2arc_log_blk_insert(l2arc_dev_t *dev, const arc_buf_hdr_t *hdr)
 	ASSERT(HDR_HAS_L2HDR(hdr));
 
 	le = &lb->lb_entries[index];
-	memset(le, 0, sizeof (*le));
-	le->le_dva = hdr->b_dva;
-	le->le_birth = hdr->b_birth;
-	le->le_daddr = hdr->b_l2hdr.b_daddr;
+	l2arc_hdr_to_log_ent(hdr, le);
 	if (index == 0)
 		dev->l2ad_log_blk_payload_start = le->le_daddr;
-	L2BLK_SET_LSIZE((le)->le_prop, HDR_GET_LSIZE(hdr));
-	L2BLK_SET_PSIZE((le)->le_prop, HDR_GET_PSIZE(hdr));
-	L2BLK_SET_COMPRESS((le)->le_prop, HDR_GET_COMPRESS(hdr));
-	le->le_complevel = hdr->b_complevel;
-	L2BLK_SET_TYPE((le)->le_prop, hdr->b_type);
-	L2BLK_SET_PROTECTED((le)->le_prop, !!(HDR_PROTECTED(hdr)));
-	L2BLK_SET_PREFETCH((le)->le_prop, !!(HDR_PREFETCH(hdr)));
-	L2BLK_SET_STATE((le)->le_prop, hdr->b_l2hdr.b_arcs_state);
 
 	dev->l2ad_log_blk_payload_asize += vdev_psize_to_asize(dev->l2ad_vdev,
 	    HDR_GET_PSIZE(hdr));
@@ -11722,6 +13007,24 @@ ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, pc_percent, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, average_blocksize, UINT, ZMOD_RD,
 	"Target average block size");
 
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, lockless_lookup, INT, ZMOD_RW,
+	"Resolve ARC hash misses on empty buckets without the hash lock");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, admission_filter, INT, ZMOD_RW,
+	"Only cache data blocks with enough recent requests when ARC is full");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, admission_threshold, UINT, ZMOD_RW,
+	"Recent requests needed for a new data block to be cached (max 15)");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, warm_enabled, INT, ZMOD_RW,
+	"Save hot ARC blocks on export and prefetch them on import");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, warm_max_blocks, UINT, ZMOD_RW,
+	"Max number of hot blocks saved per pool for ARC warm-start");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, warm_rate, UINT, ZMOD_RW,
+	"Max blocks per second prefetched while warming up the ARC");
+
 ZFS_MODULE_PARAM(zfs, zfs_, compressed_arc_enabled, INT, ZMOD_RW,
 	"Disable compressed ARC buffers");
 
@@ -11748,6 +13051,22 @@ ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, headroom_boost, U64, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, trim_ahead, U64, ZMOD_RW,
 	"TRIM ahead L2ARC write size multiplier");
 
+ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, retain_hits, UINT, ZMOD_RW,
+	"Rewrite L2-only buffers with this many hits instead of evicting");
+
+ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, retain_pct, UINT, ZMOD_RW,
+	"Max share of each L2ARC write used for retained buffers");
+
+ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, write_adaptive, INT, ZMOD_RW,
+	"Adapt the L2ARC write rate to the read hits it gains");
+
+ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, write_busy_pct, UINT, ZMOD_RW,
+	"Halve the adaptive L2ARC write rate when writes take longer than "
+	"this percent of the feed interval");
+
+ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, write_gain_pct, UINT, ZMOD_RW,
+	"Min L2ARC hit bytes per 100 bytes written to raise the write rate");
+
 ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, feed_secs, U64, ZMOD_RW,
 	"Seconds between L2ARC writing");
 
@@ -11814,3 +13133,9 @@ ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, prune_task_threads, INT, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, evict_threads, UINT, ZMOD_RD,
 	"Number of threads to use for ARC eviction.");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, evict_numa, INT, ZMOD_RD,
+	"Evict from the NUMA node under memory pressure first");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, evict_cost_ms, UINT, ZMOD_RW,
+	"Extra lifetime per unit of refetch cost before eviction (0=off)");
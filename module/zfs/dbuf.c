@@ -57,6 +57,7 @@
 #include <sys/spa_impl.h>
 #include <sys/wmsum.h>
 #include <sys/vdev_impl.h>
+#include <sys/zthr.h>
 
 static kstat_t *dbuf_ksp;
 
@@ -77,6 +78,13 @@ typedef struct dbuf_stats {
 	 * Total number of dbuf cache evictions that have occurred.
 	 */
 	kstat_named_t cache_total_evicts;
+	/*
+	 * Number of dbufs created again shortly after the dbuf cache evicted
+	 * them, split by the cache that would have kept them, see
+	 * dbuf_cache_adapt().
+	 */
+	kstat_named_t cache_ghost_hits;
+	kstat_named_t metadata_cache_ghost_hits;
 	/*
 	 * The distribution of dbuf levels in the dbuf cache and
 	 * the total size of all dbufs at each level.
@@ -106,12 +114,32 @@ typedef struct dbuf_stats {
 	 */
 	kstat_named_t hash_table_count;
 	kstat_named_t hash_mutex_count;
+	/*
+	 * Number of times the hash table started growing, see
+	 * dbuf_hash_grow().
+	 */
+	kstat_named_t hash_table_grows;
+	/*
+	 * Number of level-0 holds taken by dbuf_hold_cached() without the
+	 * dn_struct_rwlock, of those that had to fall back to dbuf_hold()
+	 * because the dbuf was not cached and clean, and of holds taken by
+	 * dbuf_hold_impl().
+	 */
+	kstat_named_t hold_fast_hits;
+	kstat_named_t hold_fast_misses;
+	kstat_named_t hold_slow;
+	/*
+	 * Number of dbufs created by dbuf_hold_array() with the parent found
+	 * for the previous block.
+	 */
+	kstat_named_t hold_parent_reuse;
 	/*
 	 * Statistics about the size of the metadata dbuf cache.
 	 */
 	kstat_named_t metadata_cache_count;
 	kstat_named_t metadata_cache_size_bytes;
 	kstat_named_t metadata_cache_size_bytes_max;
+	kstat_named_t metadata_cache_target_bytes;
 	/*
 	 * For diagnostic purposes, this is incremented whenever we can't add
 	 * something to the metadata cache because it's full, and instead put
@@ -128,6 +156,8 @@ dbuf_stats_t dbuf_stats = {
 	{ "cache_lowater_bytes",		KSTAT_DATA_UINT64 },
 	{ "cache_hiwater_bytes",		KSTAT_DATA_UINT64 },
 	{ "cache_total_evicts",			KSTAT_DATA_UINT64 },
+	{ "cache_ghost_hits",			KSTAT_DATA_UINT64 },
+	{ "metadata_cache_ghost_hits",		KSTAT_DATA_UINT64 },
 	{ { "cache_levels_N",			KSTAT_DATA_UINT64 } },
 	{ { "cache_levels_bytes_N",		KSTAT_DATA_UINT64 } },
 	{ "hash_hits",				KSTAT_DATA_UINT64 },
@@ -139,15 +169,23 @@ dbuf_stats_t dbuf_stats = {
 	{ "hash_insert_race",			KSTAT_DATA_UINT64 },
 	{ "hash_table_count",			KSTAT_DATA_UINT64 },
 	{ "hash_mutex_count",			KSTAT_DATA_UINT64 },
+	{ "hash_table_grows",			KSTAT_DATA_UINT64 },
+	{ "hold_fast_hits",			KSTAT_DATA_UINT64 },
+	{ "hold_fast_misses",			KSTAT_DATA_UINT64 },
+	{ "hold_slow",				KSTAT_DATA_UINT64 },
+	{ "hold_parent_reuse",			KSTAT_DATA_UINT64 },
 	{ "metadata_cache_count",		KSTAT_DATA_UINT64 },
 	{ "metadata_cache_size_bytes",		KSTAT_DATA_UINT64 },
 	{ "metadata_cache_size_bytes_max",	KSTAT_DATA_UINT64 },
+	{ "metadata_cache_target_bytes",	KSTAT_DATA_UINT64 },
 	{ "metadata_cache_overflow",		KSTAT_DATA_UINT64 }
 };
 
 struct {
 	wmsum_t cache_count;
 	wmsum_t cache_total_evicts;
+	wmsum_t cache_ghost_hits;
+	wmsum_t metadata_cache_ghost_hits;
 	wmsum_t cache_levels[DN_MAX_LEVELS];
 	wmsum_t cache_levels_bytes[DN_MAX_LEVELS];
 	wmsum_t hash_hits;
@@ -156,6 +194,11 @@ struct {
 	wmsum_t hash_elements;
 	wmsum_t hash_chains;
 	wmsum_t hash_insert_race;
+	wmsum_t hash_table_grows;
+	wmsum_t hold_fast_hits;
+	wmsum_t hold_fast_misses;
+	wmsum_t hold_slow;
+	wmsum_t hold_parent_reuse;
 	wmsum_t metadata_cache_count;
 	wmsum_t metadata_cache_overflow;
 } dbuf_sums;
@@ -235,9 +278,46 @@ static uint64_t dbuf_metadata_cache_max_bytes = UINT64_MAX;
 static uint_t dbuf_cache_shift = 5;
 static uint_t dbuf_metadata_cache_shift = 6;
 
+/*
+ * Let dbuf_cache_adapt() move space between the dbuf cache and the metadata
+ * dbuf cache.  dbuf_cache_share is the dbuf cache's part of their combined
+ * target, in units of 1/DBUF_CACHE_SHARE_MAX (0 until first adjusted).
+ */
+static int dbuf_cache_adaptive = 0;
+static uint_t dbuf_cache_share = 0;
+static hrtime_t dbuf_cache_adapt_time;
+static uint64_t dbuf_cache_adapt_hits[2];
+
+#define	DBUF_CACHE_SHARE_MAX	1000
+#define	DBUF_CACHE_SHARE_STEP	10
+
+/*
+ * Evicted dbufs leave a tag in a direct-mapped table indexed by their hash,
+ * so that creating the same dbuf again can be counted as a ghost hit.
+ * Bit 0 marks a valid entry, bit 1 one that the metadata cache would have
+ * kept had it not been full.
+ */
+#define	DBUF_GHOST_SHIFT	16
+#define	DBUF_GHOST_MASK		((1ULL << DBUF_GHOST_SHIFT) - 1)
+#define	DBUF_GHOST_TAG(hv)	((uint32_t)((hv) >> 32) | 1)
+#define	DBUF_GHOST_METADATA	2
+static uint32_t *dbuf_ghosts;
+
 /* Set the dbuf hash mutex count as log2 shift (dynamic by default) */
 static uint_t dbuf_mutex_cache_shift = 0;
 
+/*
+ * Grow the dbuf hash table once it holds more than this many dbufs per
+ * bucket on average (0 disables growing).
+ */
+static uint_t dbuf_hash_max_load = 2;
+
+/* Buckets moved to the new table per hash mutex hold while growing. */
+#define	DBUF_HASH_GROW_STEP	8
+
+/* Take holds on cached, clean level-0 dbufs without the dn_struct_rwlock */
+static int dbuf_hold_fast = 1;
+
 static unsigned long dbuf_cache_target_bytes(void);
 static unsigned long dbuf_metadata_cache_target_bytes(void);
 
@@ -318,6 +398,7 @@ dbuf_dest(void *vdb, void *unused)
  * dbuf hash table routines
  */
 static dbuf_hash_table_t dbuf_hash_table;
+static zthr_t *dbuf_hash_grow_zthr;
 
 /*
  * We use Cityhash for this. It's fast, and has good hash properties without
@@ -345,24 +426,22 @@ dbuf_find(objset_t *os, uint64_t obj, uint8_t level, uint64_t blkid,
 {
 	dbuf_hash_table_t *h = &dbuf_hash_table;
 	uint64_t hv;
-	uint64_t idx;
 	dmu_buf_impl_t *db;
 
 	hv = dbuf_hash(os, obj, level, blkid);
-	idx = hv & h->hash_table_mask;
 
-	mutex_enter(DBUF_HASH_MUTEX(h, idx));
-	for (db = h->hash_table[idx]; db != NULL; db = db->db_hash_next) {
+	mutex_enter(DBUF_HASH_MUTEX(h, hv));
+	for (db = *dbuf_hash_chain(h, hv); db != NULL; db = db->db_hash_next) {
 		if (DBUF_EQUAL(db, os, obj, level, blkid)) {
 			mutex_enter(&db->db_mtx);
 			if (db->db_state != DB_EVICTING) {
-				mutex_exit(DBUF_HASH_MUTEX(h, idx));
+				mutex_exit(DBUF_HASH_MUTEX(h, hv));
 				return (db);
 			}
 			mutex_exit(&db->db_mtx);
 		}
 	}
-	mutex_exit(DBUF_HASH_MUTEX(h, idx));
+	mutex_exit(DBUF_HASH_MUTEX(h, hv));
 	if (hash_out != NULL)
 		*hash_out = hv;
 	return (NULL);
@@ -386,6 +465,113 @@ dbuf_find_bonus(objset_t *os, uint64_t object)
 	return (db);
 }
 
+/*
+ * Move up to DBUF_HASH_GROW_STEP buckets of the old hash table to the new
+ * one, and make the new table current once all of them have been moved.
+ * Each bucket is moved under its own mutex, which also protects the two
+ * buckets it is split into, so lookups are never held up for long.
+ * Returns B_TRUE while there are buckets left to move.
+ */
+static boolean_t
+dbuf_hash_grow_step(dbuf_hash_table_t *h)
+{
+	uint64_t size = h->hash_table_mask + 1;
+	dmu_buf_impl_t **old = h->hash_table;
+	dmu_buf_impl_t **new = h->hash_table_new;
+
+	ASSERT3P(new, !=, NULL);
+
+	for (int n = 0; n < DBUF_HASH_GROW_STEP && h->hash_table_split < size;
+	    n++) {
+		uint64_t idx = h->hash_table_split;
+		dmu_buf_impl_t *db, *next;
+		uint64_t len[2] = { 0, 0 };
+		uint64_t oldlen = 0;
+
+		mutex_enter(DBUF_HASH_MUTEX(h, idx));
+		for (db = old[idx]; db != NULL; db = next) {
+			uint64_t nidx = db->db_hash & (2 * size - 1);
+
+			next = db->db_hash_next;
+			db->db_hash_next = new[nidx];
+			new[nidx] = db;
+			len[nidx >= size]++;
+			oldlen++;
+		}
+		old[idx] = NULL;
+		if (oldlen > 1)
+			DBUF_STAT_BUMPDOWN(hash_chains);
+		for (int i = 0; i < 2; i++) {
+			if (len[i] > 1)
+				DBUF_STAT_BUMP(hash_chains);
+		}
+		h->hash_table_split = idx + 1;
+		mutex_exit(DBUF_HASH_MUTEX(h, idx));
+	}
+
+	if (h->hash_table_split < size)
+		return (B_TRUE);
+
+	/*
+	 * Every bucket has moved.  Lookups find the table through the mask,
+	 * so switch over with all the mutexes held.
+	 */
+	for (uint64_t i = 0; i <= h->hash_mutex_mask; i++)
+		mutex_enter(&h->hash_mutexes[i]);
+	h->hash_table = new;
+	h->hash_table_mask = 2 * size - 1;
+	h->hash_table_new = NULL;
+	h->hash_table_split = 0;
+	for (uint64_t i = 0; i <= h->hash_mutex_mask; i++)
+		mutex_exit(&h->hash_mutexes[i]);
+
+	vmem_free(old, size * sizeof (void *));
+	return (B_FALSE);
+}
+
+/*
+ * The dbuf_hash_grow zthr checks about once a second whether the table
+ * holds more than dbuf_hash_max_load dbufs per bucket, or was left half
+ * grown by a cancellation.
+ */
+static boolean_t
+dbuf_hash_grow_cb_check(void *arg, zthr_t *zthr)
+{
+	(void) zthr;
+	dbuf_hash_table_t *h = arg;
+
+	return (h->hash_table_new != NULL || (dbuf_hash_max_load != 0 &&
+	    wmsum_value(&dbuf_sums.hash_elements) >
+	    (h->hash_table_mask + 1) * dbuf_hash_max_load));
+}
+
+/*
+ * Double the table.  Only this thread grows it, so the allocation may
+ * sleep and the buckets are moved without holding up dbuf_hash_insert().
+ */
+static void
+dbuf_hash_grow_cb(void *arg, zthr_t *zthr)
+{
+	dbuf_hash_table_t *h = arg;
+
+	if (h->hash_table_new == NULL) {
+		uint64_t size = h->hash_table_mask + 1;
+
+		/*
+		 * No bucket is below hash_table_split yet, so publishing the
+		 * new table does not change where lookups go.
+		 */
+		dmu_buf_impl_t **new = vmem_zalloc(2 * size * sizeof (void *),
+		    KM_SLEEP);
+		ASSERT0(h->hash_table_split);
+		h->hash_table_new = new;
+		DBUF_STAT_BUMP(hash_table_grows);
+	}
+
+	while (!zthr_iscancelled(zthr) && dbuf_hash_grow_step(h))
+		;
+}
+
 /*
  * Insert an entry into the hash table.  If there is already an element
  * equal to elem in the hash table, then the already existing element
@@ -399,21 +585,22 @@ dbuf_hash_insert(dmu_buf_impl_t *db)
 	objset_t *os = db->db_objset;
 	uint64_t obj = db->db.db_object;
 	int level = db->db_level;
-	uint64_t blkid, idx;
-	dmu_buf_impl_t *dbf;
+	uint64_t blkid, hv;
+	dmu_buf_impl_t *dbf, **chain;
 	uint32_t i;
 
 	blkid = db->db_blkid;
-	ASSERT3U(dbuf_hash(os, obj, level, blkid), ==, db->db_hash);
-	idx = db->db_hash & h->hash_table_mask;
+	hv = db->db_hash;
+	ASSERT3U(dbuf_hash(os, obj, level, blkid), ==, hv);
 
-	mutex_enter(DBUF_HASH_MUTEX(h, idx));
-	for (dbf = h->hash_table[idx], i = 0; dbf != NULL;
+	mutex_enter(DBUF_HASH_MUTEX(h, hv));
+	chain = dbuf_hash_chain(h, hv);
+	for (dbf = *chain, i = 0; dbf != NULL;
 	    dbf = dbf->db_hash_next, i++) {
 		if (DBUF_EQUAL(dbf, os, obj, level, blkid)) {
 			mutex_enter(&dbf->db_mtx);
 			if (dbf->db_state != DB_EVICTING) {
-				mutex_exit(DBUF_HASH_MUTEX(h, idx));
+				mutex_exit(DBUF_HASH_MUTEX(h, hv));
 				return (dbf);
 			}
 			mutex_exit(&dbf->db_mtx);
@@ -429,9 +616,9 @@ dbuf_hash_insert(dmu_buf_impl_t *db)
 	}
 
 	mutex_enter(&db->db_mtx);
-	db->db_hash_next = h->hash_table[idx];
-	h->hash_table[idx] = db;
-	mutex_exit(DBUF_HASH_MUTEX(h, idx));
+	db->db_hash_next = *chain;
+	*chain = db;
+	mutex_exit(DBUF_HASH_MUTEX(h, hv));
 	DBUF_STAT_BUMP(hash_elements);
 
 	return (NULL);
@@ -443,7 +630,7 @@ dbuf_hash_insert(dmu_buf_impl_t *db)
  * to traversing dataset hierarchies.
  */
 static boolean_t
-dbuf_include_in_metadata_cache(dmu_buf_impl_t *db)
+dbuf_metadata_cached_type(dmu_buf_impl_t *db)
 {
 	DB_DNODE_ENTER(db);
 	dnode_t *dn = DB_DNODE(db);
@@ -452,11 +639,17 @@ dbuf_include_in_metadata_cache(dmu_buf_impl_t *db)
 		type = dn->dn_type;
 	DB_DNODE_EXIT(db);
 
-	/* Check if this dbuf is one of the types we care about */
-	if (DMU_OT_IS_METADATA_CACHED(type)) {
-		/* If we hit this, then we set something up wrong in dmu_ot */
-		ASSERT(DMU_OT_IS_METADATA(type));
+	/* If we hit this, then we set something up wrong in dmu_ot */
+	ASSERT(!DMU_OT_IS_METADATA_CACHED(type) || DMU_OT_IS_METADATA(type));
 
+	return (DMU_OT_IS_METADATA_CACHED(type));
+}
+
+static boolean_t
+dbuf_include_in_metadata_cache(dmu_buf_impl_t *db)
+{
+	/* Check if this dbuf is one of the types we care about */
+	if (dbuf_metadata_cached_type(db)) {
 		/*
 		 * Sanity check for small-memory systems: don't allocate too
 		 * much memory for this purpose.
@@ -481,12 +674,11 @@ static void
 dbuf_hash_remove(dmu_buf_impl_t *db)
 {
 	dbuf_hash_table_t *h = &dbuf_hash_table;
-	uint64_t idx;
-	dmu_buf_impl_t *dbf, **dbp;
+	uint64_t hv = db->db_hash;
+	dmu_buf_impl_t *dbf, **dbp, **chain;
 
 	ASSERT3U(dbuf_hash(db->db_objset, db->db.db_object, db->db_level,
-	    db->db_blkid), ==, db->db_hash);
-	idx = db->db_hash & h->hash_table_mask;
+	    db->db_blkid), ==, hv);
 
 	/*
 	 * We mustn't hold db_mtx to maintain lock ordering:
@@ -496,18 +688,17 @@ dbuf_hash_remove(dmu_buf_impl_t *db)
 	ASSERT(db->db_state == DB_EVICTING);
 	ASSERT(!MUTEX_HELD(&db->db_mtx));
 
-	mutex_enter(DBUF_HASH_MUTEX(h, idx));
-	dbp = &h->hash_table[idx];
+	mutex_enter(DBUF_HASH_MUTEX(h, hv));
+	chain = dbp = dbuf_hash_chain(h, hv);
 	while ((dbf = *dbp) != db) {
 		dbp = &dbf->db_hash_next;
 		ASSERT(dbf != NULL);
 	}
 	*dbp = db->db_hash_next;
 	db->db_hash_next = NULL;
-	if (h->hash_table[idx] &&
-	    h->hash_table[idx]->db_hash_next == NULL)
+	if (*chain && (*chain)->db_hash_next == NULL)
 		DBUF_STAT_BUMPDOWN(hash_chains);
-	mutex_exit(DBUF_HASH_MUTEX(h, idx));
+	mutex_exit(DBUF_HASH_MUTEX(h, hv));
 	DBUF_STAT_BUMPDOWN(hash_elements);
 }
 
@@ -725,6 +916,26 @@ dbuf_cache_multilist_index_func(multilist_t *ml, void *obj)
 	    multilist_get_num_sublists(ml));
 }
 
+/*
+ * The two caches get log2 fractions of the ARC target.  With
+ * dbuf_cache_adaptive, their sum is instead split by dbuf_cache_share.
+ */
+static uint64_t
+dbuf_cache_split_bytes(boolean_t metadata)
+{
+	uint64_t target = arc_target_bytes();
+	uint64_t data = target >> dbuf_cache_shift;
+	uint64_t meta = target >> dbuf_metadata_cache_shift;
+	uint_t share = dbuf_cache_share;
+
+	if (!dbuf_cache_adaptive || share == 0)
+		return (metadata ? meta : data);
+
+	uint64_t total = data + meta;
+	data = total / DBUF_CACHE_SHARE_MAX * share;
+	return (metadata ? total - data : data);
+}
+
 /*
  * The target size of the dbuf cache can grow with the ARC target,
  * unless limited by the tunable dbuf_cache_max_bytes.
@@ -732,8 +943,7 @@ dbuf_cache_multilist_index_func(multilist_t *ml, void *obj)
 static inline unsigned long
 dbuf_cache_target_bytes(void)
 {
-	return (MIN(dbuf_cache_max_bytes,
-	    arc_target_bytes() >> dbuf_cache_shift));
+	return (MIN(dbuf_cache_max_bytes, dbuf_cache_split_bytes(B_FALSE)));
 }
 
 /*
@@ -744,7 +954,82 @@ static inline unsigned long
 dbuf_metadata_cache_target_bytes(void)
 {
 	return (MIN(dbuf_metadata_cache_max_bytes,
-	    arc_target_bytes() >> dbuf_metadata_cache_shift));
+	    dbuf_cache_split_bytes(B_TRUE)));
+}
+
+/*
+ * Once a second, move up to DBUF_CACHE_SHARE_STEP of the combined target
+ * towards the cache that saw more ghost hits, i.e. the one that would have
+ * avoided more misses had it been larger.  The sum stays the same, so the
+ * ARC is not squeezed, and neither cache drops below a tenth of it.
+ */
+static void
+dbuf_cache_adapt(void)
+{
+	hrtime_t now = gethrtime();
+
+	if (!dbuf_cache_adaptive) {
+		dbuf_cache_share = 0;
+		return;
+	}
+	if (now - dbuf_cache_adapt_time < SEC2NSEC(1))
+		return;
+	dbuf_cache_adapt_time = now;
+
+	uint64_t data = wmsum_value(&dbuf_sums.cache_ghost_hits);
+	uint64_t meta = wmsum_value(&dbuf_sums.metadata_cache_ghost_hits);
+	int64_t ddata = data - dbuf_cache_adapt_hits[0];
+	int64_t dmeta = meta - dbuf_cache_adapt_hits[1];
+	dbuf_cache_adapt_hits[0] = data;
+	dbuf_cache_adapt_hits[1] = meta;
+
+	int64_t share = dbuf_cache_share;
+	if (share == 0) {
+		uint64_t target = arc_target_bytes();
+		data = target >> dbuf_cache_shift;
+		meta = target >> dbuf_metadata_cache_shift;
+		if (data + meta == 0)
+			return;
+		share = data * DBUF_CACHE_SHARE_MAX / (data + meta);
+	}
+	if (ddata + dmeta > 0) {
+		share += DBUF_CACHE_SHARE_STEP * (ddata - dmeta) /
+		    (ddata + dmeta);
+	}
+	dbuf_cache_share = MIN(MAX(share, DBUF_CACHE_SHARE_MAX / 10),
+	    DBUF_CACHE_SHARE_MAX - DBUF_CACHE_SHARE_MAX / 10);
+}
+
+/*
+ * Remember a dbuf evicted from the dbuf cache, see DBUF_GHOST_TAG().
+ */
+static void
+dbuf_ghost_add(dmu_buf_impl_t *db)
+{
+	uint32_t tag = DBUF_GHOST_TAG(db->db_hash);
+
+	if (dbuf_metadata_cached_type(db))
+		tag |= DBUF_GHOST_METADATA;
+	dbuf_ghosts[db->db_hash & DBUF_GHOST_MASK] = tag;
+}
+
+/*
+ * Count a ghost hit if the dbuf being created was recently evicted.  The
+ * table is read and written without locks; a lost update only loses a hint.
+ */
+static void
+dbuf_ghost_check(uint64_t hv)
+{
+	uint32_t *gp = &dbuf_ghosts[hv & DBUF_GHOST_MASK];
+	uint32_t tag = *gp;
+
+	if ((tag & ~DBUF_GHOST_METADATA) != DBUF_GHOST_TAG(hv))
+		return;
+	*gp = 0;
+	if (tag & DBUF_GHOST_METADATA)
+		DBUF_STAT_BUMP(metadata_cache_ghost_hits);
+	else
+		DBUF_STAT_BUMP(cache_ghost_hits);
 }
 
 static inline uint64_t
@@ -804,6 +1089,8 @@ dbuf_evict_one(void)
 		DBUF_STAT_DECR(cache_levels_bytes[db->db_level], size + usize);
 		ASSERT3U(db->db_caching_status, ==, DB_DBUF_CACHE);
 		db->db_caching_status = DB_NO_CACHE;
+		if (dbuf_cache_adaptive)
+			dbuf_ghost_add(db);
 		dbuf_destroy(db);
 		DBUF_STAT_BUMP(cache_total_evicts);
 	} else {
@@ -833,6 +1120,7 @@ dbuf_evict_thread(void *unused)
 			(void) cv_timedwait_idle_hires(&dbuf_evict_cv,
 			    &dbuf_evict_lock, SEC2NSEC(1), MSEC2NSEC(1), 0);
 			CALLB_CPR_SAFE_END(&cpr, &dbuf_evict_lock);
+			dbuf_cache_adapt();
 		}
 		mutex_exit(&dbuf_evict_lock);
 
@@ -843,6 +1131,7 @@ dbuf_evict_thread(void *unused)
 		 */
 		while (dbuf_cache_above_lowater() && !dbuf_evict_thread_exit) {
 			dbuf_evict_one();
+			dbuf_cache_adapt();
 		}
 
 		mutex_enter(&dbuf_evict_lock);
@@ -913,6 +1202,10 @@ dbuf_kstat_update(kstat_t *ksp, int rw)
 	ds->cache_lowater_bytes.value.ui64 = dbuf_cache_lowater_bytes();
 	ds->cache_total_evicts.value.ui64 =
 	    wmsum_value(&dbuf_sums.cache_total_evicts);
+	ds->cache_ghost_hits.value.ui64 =
+	    wmsum_value(&dbuf_sums.cache_ghost_hits);
+	ds->metadata_cache_ghost_hits.value.ui64 =
+	    wmsum_value(&dbuf_sums.metadata_cache_ghost_hits);
 	for (int i = 0; i < DN_MAX_LEVELS; i++) {
 		ds->cache_levels[i].value.ui64 =
 		    wmsum_value(&dbuf_sums.cache_levels[i]);
@@ -933,10 +1226,22 @@ dbuf_kstat_update(kstat_t *ksp, int rw)
 	    wmsum_value(&dbuf_sums.hash_insert_race);
 	ds->hash_table_count.value.ui64 = h->hash_table_mask + 1;
 	ds->hash_mutex_count.value.ui64 = h->hash_mutex_mask + 1;
+	ds->hash_table_grows.value.ui64 =
+	    wmsum_value(&dbuf_sums.hash_table_grows);
+	ds->hold_fast_hits.value.ui64 =
+	    wmsum_value(&dbuf_sums.hold_fast_hits);
+	ds->hold_fast_misses.value.ui64 =
+	    wmsum_value(&dbuf_sums.hold_fast_misses);
+	ds->hold_slow.value.ui64 =
+	    wmsum_value(&dbuf_sums.hold_slow);
+	ds->hold_parent_reuse.value.ui64 =
+	    wmsum_value(&dbuf_sums.hold_parent_reuse);
 	ds->metadata_cache_count.value.ui64 =
 	    wmsum_value(&dbuf_sums.metadata_cache_count);
 	ds->metadata_cache_size_bytes.value.ui64 = zfs_refcount_count(
 	    &dbuf_caches[DB_DBUF_METADATA_CACHE].size);
+	ds->metadata_cache_target_bytes.value.ui64 =
+	    dbuf_metadata_cache_target_bytes();
 	ds->metadata_cache_overflow.value.ui64 =
 	    wmsum_value(&dbuf_sums.metadata_cache_overflow);
 	return (0);
@@ -971,12 +1276,14 @@ dbuf_init(void)
 	/*
 	 * The hash table buckets are protected by an array of mutexes where
 	 * each mutex is reponsible for protecting 128 buckets.  A minimum
-	 * array size of 8192 is targeted to avoid contention.
+	 * array size of 8192 is targeted to avoid contention.  There may not
+	 * be more mutexes than buckets, see dbuf_hash_chain().
 	 */
 	if (dbuf_mutex_cache_shift == 0)
 		hmsize = MAX(hsize >> 7, 1ULL << 13);
 	else
 		hmsize = 1ULL << MIN(dbuf_mutex_cache_shift, 24);
+	hmsize = MIN(hmsize, hsize);
 
 	h->hash_mutexes = NULL;
 	while (h->hash_mutexes == NULL) {
@@ -996,6 +1303,11 @@ dbuf_init(void)
 
 	for (int i = 0; i < hmsize; i++)
 		mutex_init(&h->hash_mutexes[i], NULL, MUTEX_NOLOCKDEP, NULL);
+	h->hash_table_new = NULL;
+	h->hash_table_split = 0;
+
+	dbuf_ghosts = vmem_zalloc((DBUF_GHOST_MASK + 1) * sizeof (uint32_t),
+	    KM_SLEEP);
 
 	dbuf_stats_init(h);
 
@@ -1021,6 +1333,8 @@ dbuf_init(void)
 
 	wmsum_init(&dbuf_sums.cache_count, 0);
 	wmsum_init(&dbuf_sums.cache_total_evicts, 0);
+	wmsum_init(&dbuf_sums.cache_ghost_hits, 0);
+	wmsum_init(&dbuf_sums.metadata_cache_ghost_hits, 0);
 	for (int i = 0; i < DN_MAX_LEVELS; i++) {
 		wmsum_init(&dbuf_sums.cache_levels[i], 0);
 		wmsum_init(&dbuf_sums.cache_levels_bytes[i], 0);
@@ -1031,9 +1345,18 @@ dbuf_init(void)
 	wmsum_init(&dbuf_sums.hash_elements, 0);
 	wmsum_init(&dbuf_sums.hash_chains, 0);
 	wmsum_init(&dbuf_sums.hash_insert_race, 0);
+	wmsum_init(&dbuf_sums.hash_table_grows, 0);
+	wmsum_init(&dbuf_sums.hold_fast_hits, 0);
+	wmsum_init(&dbuf_sums.hold_fast_misses, 0);
+	wmsum_init(&dbuf_sums.hold_slow, 0);
+	wmsum_init(&dbuf_sums.hold_parent_reuse, 0);
 	wmsum_init(&dbuf_sums.metadata_cache_count, 0);
 	wmsum_init(&dbuf_sums.metadata_cache_overflow, 0);
 
+	dbuf_hash_grow_zthr = zthr_create_timer("dbuf_hash_grow",
+	    dbuf_hash_grow_cb_check, dbuf_hash_grow_cb, h, SEC2NSEC(1),
+	    minclsyspri);
+
 	dbuf_ksp = kstat_create("zfs", 0, "dbufstats", "misc",
 	    KSTAT_TYPE_NAMED, sizeof (dbuf_stats) / sizeof (kstat_named_t),
 	    KSTAT_FLAG_VIRTUAL);
@@ -1059,14 +1382,22 @@ dbuf_fini(void)
 {
 	dbuf_hash_table_t *h = &dbuf_hash_table;
 
+	zthr_cancel(dbuf_hash_grow_zthr);
+	zthr_destroy(dbuf_hash_grow_zthr);
+
 	dbuf_stats_destroy();
 
 	for (int i = 0; i < (h->hash_mutex_mask + 1); i++)
 		mutex_destroy(&h->hash_mutexes[i]);
 
 	vmem_free(h->hash_table, (h->hash_table_mask + 1) * sizeof (void *));
+	if (h->hash_table_new != NULL) {
+		vmem_free(h->hash_table_new,
+		    2 * (h->hash_table_mask + 1) * sizeof (void *));
+	}
 	vmem_free(h->hash_mutexes, (h->hash_mutex_mask + 1) *
 	    sizeof (kmutex_t));
+	vmem_free(dbuf_ghosts, (DBUF_GHOST_MASK + 1) * sizeof (uint32_t));
 
 	kmem_cache_destroy(dbuf_kmem_cache);
 	kmem_cache_destroy(dbuf_dirty_kmem_cache);
@@ -1095,6 +1426,8 @@ dbuf_fini(void)
 
 	wmsum_fini(&dbuf_sums.cache_count);
 	wmsum_fini(&dbuf_sums.cache_total_evicts);
+	wmsum_fini(&dbuf_sums.cache_ghost_hits);
+	wmsum_fini(&dbuf_sums.metadata_cache_ghost_hits);
 	for (int i = 0; i < DN_MAX_LEVELS; i++) {
 		wmsum_fini(&dbuf_sums.cache_levels[i]);
 		wmsum_fini(&dbuf_sums.cache_levels_bytes[i]);
@@ -1105,6 +1438,11 @@ dbuf_fini(void)
 	wmsum_fini(&dbuf_sums.hash_elements);
 	wmsum_fini(&dbuf_sums.hash_chains);
 	wmsum_fini(&dbuf_sums.hash_insert_race);
+	wmsum_fini(&dbuf_sums.hash_table_grows);
+	wmsum_fini(&dbuf_sums.hold_fast_hits);
+	wmsum_fini(&dbuf_sums.hold_fast_misses);
+	wmsum_fini(&dbuf_sums.hold_slow);
+	wmsum_fini(&dbuf_sums.hold_parent_reuse);
 	wmsum_fini(&dbuf_sums.metadata_cache_count);
 	wmsum_fini(&dbuf_sums.metadata_cache_overflow);
 }
@@ -3584,6 +3922,8 @@ dbuf_create(dnode_t *dn, uint8_t level, uint64_t blkid,
 	DTRACE_SET_STATE(db, "regular buffer created");
 	db->db_caching_status = DB_NO_CACHE;
 	mutex_exit(&dn->dn_dbufs_mtx);
+	if (dbuf_cache_adaptive)
+		dbuf_ghost_check(hash);
 	arc_space_consume(sizeof (dmu_buf_impl_t), ARC_SPACE_DBUF);
 
 	if (parent && parent != dn->dn_dbuf)
@@ -3982,14 +4322,50 @@ dbuf_hold_copy(dnode_t *dn, dmu_buf_impl_t *db)
 	dbuf_set_data(db, db_data);
 }
 
+/*
+ * Take an unheld dbuf off the dbuf cache it is on, as it is about to be held.
+ */
+static void
+dbuf_cache_remove(dmu_buf_impl_t *db)
+{
+	ASSERT(MUTEX_HELD(&db->db_mtx));
+	ASSERT(zfs_refcount_is_zero(&db->db_holds));
+	ASSERT(db->db_caching_status == DB_DBUF_CACHE ||
+	    db->db_caching_status == DB_DBUF_METADATA_CACHE);
+
+	multilist_remove(&dbuf_caches[db->db_caching_status].cache, db);
+
+	uint64_t size = db->db.db_size;
+	uint64_t usize = dmu_buf_user_size(&db->db);
+	(void) zfs_refcount_remove_many(
+	    &dbuf_caches[db->db_caching_status].size, size, db);
+	(void) zfs_refcount_remove_many(
+	    &dbuf_caches[db->db_caching_status].size, usize,
+	    db->db_user);
+
+	if (db->db_caching_status == DB_DBUF_METADATA_CACHE) {
+		DBUF_STAT_BUMPDOWN(metadata_cache_count);
+	} else {
+		DBUF_STAT_BUMPDOWN(cache_levels[db->db_level]);
+		DBUF_STAT_BUMPDOWN(cache_count);
+		DBUF_STAT_DECR(cache_levels_bytes[db->db_level],
+		    size + usize);
+	}
+	db->db_caching_status = DB_NO_CACHE;
+}
+
 /*
  * Returns with db_holds incremented, and db_mtx not held.
  * Note: dn_struct_rwlock must be held.
+ *
+ * If lastp is not NULL, it holds on to the parent that was last looked up
+ * for a new dbuf, which is reused instead of calling dbuf_findbp() again if
+ * it is also the parent of the next one.  See dbuf_hold_array().
  */
-int
-dbuf_hold_impl(dnode_t *dn, uint8_t level, uint64_t blkid,
+static int
+dbuf_hold_impl_parent(dnode_t *dn, uint8_t level, uint64_t blkid,
     boolean_t fail_sparse, boolean_t fail_uncached,
-    const void *tag, dmu_buf_impl_t **dbp)
+    const void *tag, dmu_buf_impl_t **dbp, dmu_buf_impl_t **lastp)
 {
 	dmu_buf_impl_t *db, *parent = NULL;
 	uint64_t hv;
@@ -4018,6 +4394,19 @@ dbuf_hold_impl(dnode_t *dn, uint8_t level, uint64_t blkid,
 		if (fail_uncached)
 			return (SET_ERROR(ENOENT));
 
+		int epbs = dn->dn_indblkshift - SPA_BLKPTRSHIFT;
+		dmu_buf_impl_t *last = (lastp != NULL) ? *lastp : NULL;
+		if (last != NULL && !fail_sparse &&
+		    last->db_level == level + 1 &&
+		    last->db_blkid == blkid >> epbs &&
+		    last->db_state == DB_CACHED) {
+			DBUF_STAT_BUMP(hold_parent_reuse);
+			db = dbuf_create(dn, level, blkid, last,
+			    (blkptr_t *)last->db.db_data +
+			    (blkid & ((1ULL << epbs) - 1)), hv);
+			goto created;
+		}
+
 		ASSERT0P(parent);
 		err = dbuf_findbp(dn, level, blkid, fail_sparse, &parent, &bp);
 		if (fail_sparse) {
@@ -4033,6 +4422,7 @@ dbuf_hold_impl(dnode_t *dn, uint8_t level, uint64_t blkid,
 			return (err);
 		db = dbuf_create(dn, level, blkid, parent, bp, hv);
 	}
+created:
 
 	if (fail_uncached && db->db_state != DB_CACHED) {
 		mutex_exit(&db->db_mtx);
@@ -4062,38 +4452,21 @@ dbuf_hold_impl(dnode_t *dn, uint8_t level, uint64_t blkid,
 		}
 	}
 
-	if (multilist_link_active(&db->db_cache_link)) {
-		ASSERT(zfs_refcount_is_zero(&db->db_holds));
-		ASSERT(db->db_caching_status == DB_DBUF_CACHE ||
-		    db->db_caching_status == DB_DBUF_METADATA_CACHE);
-
-		multilist_remove(&dbuf_caches[db->db_caching_status].cache, db);
-
-		uint64_t size = db->db.db_size;
-		uint64_t usize = dmu_buf_user_size(&db->db);
-		(void) zfs_refcount_remove_many(
-		    &dbuf_caches[db->db_caching_status].size, size, db);
-		(void) zfs_refcount_remove_many(
-		    &dbuf_caches[db->db_caching_status].size, usize,
-		    db->db_user);
-
-		if (db->db_caching_status == DB_DBUF_METADATA_CACHE) {
-			DBUF_STAT_BUMPDOWN(metadata_cache_count);
-		} else {
-			DBUF_STAT_BUMPDOWN(cache_levels[db->db_level]);
-			DBUF_STAT_BUMPDOWN(cache_count);
-			DBUF_STAT_DECR(cache_levels_bytes[db->db_level],
-			    size + usize);
-		}
-		db->db_caching_status = DB_NO_CACHE;
-	}
+	if (multilist_link_active(&db->db_cache_link))
+		dbuf_cache_remove(db);
 	(void) zfs_refcount_add(&db->db_holds, tag);
 	DBUF_VERIFY(db);
 	mutex_exit(&db->db_mtx);
+	DBUF_STAT_BUMP(hold_slow);
 
 	/* NOTE: we can't rele the parent until after we drop the db_mtx */
-	if (parent)
+	if (parent != NULL && lastp != NULL) {
+		if (*lastp != NULL)
+			dbuf_rele(*lastp, NULL);
+		*lastp = parent;
+	} else if (parent != NULL) {
 		dbuf_rele(parent, NULL);
+	}
 
 	ASSERT3P(DB_DNODE(db), ==, dn);
 	ASSERT3U(db->db_blkid, ==, blkid);
@@ -4103,12 +4476,115 @@ dbuf_hold_impl(dnode_t *dn, uint8_t level, uint64_t blkid,
 	return (0);
 }
 
+int
+dbuf_hold_impl(dnode_t *dn, uint8_t level, uint64_t blkid,
+    boolean_t fail_sparse, boolean_t fail_uncached,
+    const void *tag, dmu_buf_impl_t **dbp)
+{
+	return (dbuf_hold_impl_parent(dn, level, blkid, fail_sparse,
+	    fail_uncached, tag, dbp, NULL));
+}
+
 dmu_buf_impl_t *
 dbuf_hold(dnode_t *dn, uint64_t blkid, const void *tag)
 {
 	return (dbuf_hold_level(dn, 0, blkid, tag));
 }
 
+/*
+ * Hold the nblks level-0 dbufs starting at blkid, as dbuf_hold() would, and
+ * store them in dbp.  Rather than walking the indirect tree for each dbuf
+ * that has to be created, the indirect block found for one is kept held and
+ * used for the following ones until the run crosses into the next indirect
+ * block, so a run of small blocks costs one parent lookup per indirect
+ * block.  On failure, nothing is left held.
+ * Note: dn_struct_rwlock must be held.
+ */
+int
+dbuf_hold_array(dnode_t *dn, uint64_t blkid, uint64_t nblks,
+    const void *tag, dmu_buf_t **dbp)
+{
+	dmu_buf_impl_t *db, *last = NULL;
+	int err = 0;
+	uint64_t i;
+
+	ASSERT(RW_LOCK_HELD(&dn->dn_struct_rwlock));
+
+	for (i = 0; i < nblks; i++) {
+		err = dbuf_hold_impl_parent(dn, 0, blkid + i, FALSE, FALSE,
+		    tag, &db, &last);
+		if (err != 0)
+			break;
+		dbp[i] = &db->db;
+	}
+	if (last != NULL)
+		dbuf_rele(last, NULL);
+
+	if (err != 0) {
+		while (i-- > 0) {
+			dbuf_rele((dmu_buf_impl_t *)dbp[i], tag);
+			dbp[i] = NULL;
+		}
+	}
+	return (err);
+}
+
+/*
+ * Hold the level-0 dbuf holding the given offset, without taking the
+ * dn_struct_rwlock, if it is cached and clean.  That lock keeps the block
+ * size and the block pointers stable, which only matters when a dbuf has to
+ * be created or is being written out.  A cached dbuf is found through the
+ * hash table under its db_mtx like in dbuf_hold_impl(), and the offset is
+ * checked against it in case the block size changed meanwhile.
+ *
+ * Returns NULL if the caller has to fall back to dbuf_hold() under the
+ * dn_struct_rwlock.
+ */
+dmu_buf_impl_t *
+dbuf_hold_cached(dnode_t *dn, uint64_t offset, const void *tag)
+{
+	dmu_buf_impl_t *db;
+	uint64_t blkid;
+
+	if (!dbuf_hold_fast || dn->dn_object == DMU_META_DNODE_OBJECT)
+		return (NULL);
+
+	/*
+	 * Like dbuf_whichblock(), but without asserting on a block size that
+	 * may be changing under us.
+	 */
+	uint8_t shift = dn->dn_datablkshift;
+	if (shift != 0)
+		blkid = offset >> shift;
+	else if (offset < dn->dn_datablksz)
+		blkid = 0;
+	else
+		return (NULL);
+
+	db = dbuf_find(dn->dn_objset, dn->dn_object, 0, blkid, NULL);
+	if (db == NULL) {
+		DBUF_STAT_BUMP(hold_fast_misses);
+		return (NULL);
+	}
+	if (db->db_state != DB_CACHED || db->db_dirtycnt != 0 ||
+	    db->db_data_pending != NULL || offset < db->db.db_offset ||
+	    offset >= db->db.db_offset + db->db.db_size) {
+		mutex_exit(&db->db_mtx);
+		DBUF_STAT_BUMP(hold_fast_misses);
+		return (NULL);
+	}
+
+	if (db->db_buf != NULL)
+		arc_buf_access(db->db_buf);
+	if (multilist_link_active(&db->db_cache_link))
+		dbuf_cache_remove(db);
+	(void) zfs_refcount_add(&db->db_holds, tag);
+	mutex_exit(&db->db_mtx);
+	DBUF_STAT_BUMP(hold_fast_hits);
+
+	return (db);
+}
+
 dmu_buf_impl_t *
 dbuf_hold_level(dnode_t *dn, int level, uint64_t blkid, const void *tag)
 {
@@ -5566,5 +6042,14 @@ ZFS_MODULE_PARAM(zfs_dbuf, dbuf_, cache_shift, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_dbuf, dbuf_, metadata_cache_shift, UINT, ZMOD_RW,
 	"Set size of dbuf metadata cache to log2 fraction of arc size.");
 
+ZFS_MODULE_PARAM(zfs_dbuf, dbuf_, cache_adaptive, INT, ZMOD_RW,
+	"Balance the dbuf and metadata caches by their ghost hits");
+
 ZFS_MODULE_PARAM(zfs_dbuf, dbuf_, mutex_cache_shift, UINT, ZMOD_RD,
 	"Set size of dbuf cache mutex array as log2 shift.");
+
+ZFS_MODULE_PARAM(zfs_dbuf, dbuf_, hash_max_load, UINT, ZMOD_RW,
+	"Grow the dbuf hash table above this many dbufs per bucket.");
+
+ZFS_MODULE_PARAM(zfs_dbuf, dbuf_, hold_fast, INT, ZMOD_RW,
+	"Hold cached clean dbufs without the dnode struct lock.");
@@ -39,6 +39,7 @@ typedef struct dbuf_stats_t {
 	kstat_t			*kstat;
 	dbuf_hash_table_t	*hash;
 	int			idx;
+	uint64_t		size;	/* table size when the walk started */
 } dbuf_stats_t;
 
 static dbuf_stats_t dbuf_stats_hash_table;
@@ -127,39 +128,69 @@ __dbuf_stats_hash_table_data(char *buf, size_t size, dmu_buf_impl_t *db)
 }
 
 static int
-dbuf_stats_hash_table_data(char *buf, size_t size, void *data)
+dbuf_stats_hash_chain_data(dmu_buf_impl_t *db, char **bufp, size_t *sizep)
 {
-	dbuf_stats_t *dsh = (dbuf_stats_t *)data;
-	dbuf_hash_table_t *h = dsh->hash;
-	dmu_buf_impl_t *db;
-	int length, error = 0;
-
-	ASSERT3S(dsh->idx, >=, 0);
-	ASSERT3S(dsh->idx, <=, h->hash_table_mask);
-	if (size)
-		buf[0] = 0;
+	int length;
 
-	mutex_enter(DBUF_HASH_MUTEX(h, dsh->idx));
-	for (db = h->hash_table[dsh->idx]; db != NULL; db = db->db_hash_next) {
+	for (; db != NULL; db = db->db_hash_next) {
 		/*
 		 * Returning ENOMEM will cause the data and header functions
 		 * to be called with a larger scratch buffers.
 		 */
-		if (size < 512) {
-			error = SET_ERROR(ENOMEM);
-			break;
-		}
+		if (*sizep < 512)
+			return (SET_ERROR(ENOMEM));
 
 		mutex_enter(&db->db_mtx);
 
 		if (db->db_state != DB_EVICTING) {
-			length = __dbuf_stats_hash_table_data(buf, size, db);
-			buf += length;
-			size -= length;
+			length = __dbuf_stats_hash_table_data(*bufp, *sizep,
+			    db);
+			*bufp += length;
+			*sizep -= length;
 		}
 
 		mutex_exit(&db->db_mtx);
 	}
+
+	return (0);
+}
+
+static int
+dbuf_stats_hash_table_data(char *buf, size_t size, void *data)
+{
+	dbuf_stats_t *dsh = (dbuf_stats_t *)data;
+	dbuf_hash_table_t *h = dsh->hash;
+	uint64_t cur;
+	int error = 0;
+
+	ASSERT3S(dsh->idx, >=, 0);
+	ASSERT3U(dsh->idx, <, dsh->size);
+	if (size)
+		buf[0] = 0;
+
+	/*
+	 * The walk covers the dsh->size buckets the table had when it
+	 * started.  If the table has grown since, the dbufs of bucket idx
+	 * are now in the buckets idx + k * dsh->size, all under the same
+	 * mutex, and a bucket already moved into the table still growing is
+	 * split between two of its buckets.  Listing exactly those chains
+	 * shows each dbuf once, however the table changes during the walk.
+	 */
+	mutex_enter(DBUF_HASH_MUTEX(h, dsh->idx));
+	cur = h->hash_table_mask + 1;
+	for (uint64_t b = dsh->idx; b < cur && error == 0; b += dsh->size) {
+		if (h->hash_table_new != NULL && b < h->hash_table_split) {
+			error = dbuf_stats_hash_chain_data(
+			    h->hash_table_new[b], &buf, &size);
+			if (error == 0) {
+				error = dbuf_stats_hash_chain_data(
+				    h->hash_table_new[b + cur], &buf, &size);
+			}
+		} else {
+			error = dbuf_stats_hash_chain_data(h->hash_table[b],
+			    &buf, &size);
+		}
+	}
 	mutex_exit(DBUF_HASH_MUTEX(h, dsh->idx));
 
 	return (error);
@@ -172,7 +203,9 @@ dbuf_stats_hash_table_addr(kstat_t *ksp, loff_t n)
 
 	ASSERT(MUTEX_HELD(&dsh->lock));
 
-	if (n <= dsh->hash->hash_table_mask) {
+	if (n == 0)
+		dsh->size = dsh->hash->hash_table_mask + 1;
+	if (n < dsh->size) {
 		dsh->idx = n;
 		return (dsh);
 	}
@@ -180,10 +180,13 @@ dmu_buf_hold_noread_by_dnode(dnode_t *dn, uint64_t offset,
 	uint64_t blkid;
 	dmu_buf_impl_t *db;
 
-	rw_enter(&dn->dn_struct_rwlock, RW_READER);
-	blkid = dbuf_whichblock(dn, 0, offset);
-	db = dbuf_hold(dn, blkid, tag);
-	rw_exit(&dn->dn_struct_rwlock);
+	db = dbuf_hold_cached(dn, offset, tag);
+	if (db == NULL) {
+		rw_enter(&dn->dn_struct_rwlock, RW_READER);
+		blkid = dbuf_whichblock(dn, 0, offset);
+		db = dbuf_hold(dn, blkid, tag);
+		rw_exit(&dn->dn_struct_rwlock);
+	}
 
 	if (db == NULL) {
 		*dbp = NULL;
@@ -206,10 +209,13 @@ dmu_buf_hold_noread(objset_t *os, uint64_t object, uint64_t offset,
 	err = dnode_hold(os, object, FTAG, &dn);
 	if (err)
 		return (err);
-	rw_enter(&dn->dn_struct_rwlock, RW_READER);
-	blkid = dbuf_whichblock(dn, 0, offset);
-	db = dbuf_hold(dn, blkid, tag);
-	rw_exit(&dn->dn_struct_rwlock);
+	db = dbuf_hold_cached(dn, offset, tag);
+	if (db == NULL) {
+		rw_enter(&dn->dn_struct_rwlock, RW_READER);
+		blkid = dbuf_whichblock(dn, 0, offset);
+		db = dbuf_hold(dn, blkid, tag);
+		rw_exit(&dn->dn_struct_rwlock);
+	}
 	dnode_rele(dn, FTAG);
 
 	if (db == NULL) {
@@ -548,19 +554,19 @@ dmu_buf_hold_array_by_dnode(dnode_t *dn, uint64_t offset, uint64_t length,
 		zs = dmu_zfetch_prepare(&dn->dn_zfetch, blkid, nblks,
 		    read && !(flags & DMU_DIRECTIO), B_TRUE);
 	}
-	for (i = 0; i < nblks; i++) {
-		dmu_buf_impl_t *db = dbuf_hold(dn, blkid + i, tag);
-		if (db == NULL) {
-			if (zs) {
-				dmu_zfetch_run(&dn->dn_zfetch, zs, missed,
-				    B_TRUE, (flags & DMU_UNCACHEDIO));
-			}
-			rw_exit(&dn->dn_struct_rwlock);
-			dmu_buf_rele_array(dbp, nblks, tag);
-			if (read)
-				zio_nowait(zio);
-			return (SET_ERROR(EIO));
+	if (dbuf_hold_array(dn, blkid, nblks, tag, dbp) != 0) {
+		if (zs) {
+			dmu_zfetch_run(&dn->dn_zfetch, zs, missed,
+			    B_TRUE, (flags & DMU_UNCACHEDIO));
 		}
+		rw_exit(&dn->dn_struct_rwlock);
+		dmu_buf_rele_array(dbp, nblks, tag);
+		if (read)
+			zio_nowait(zio);
+		return (SET_ERROR(EIO));
+	}
+	for (i = 0; i < nblks; i++) {
+		dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
 
 		/*
 		 * Initiate async demand data read.
@@ -583,7 +589,6 @@ dmu_buf_hold_array_by_dnode(dnode_t *dn, uint64_t offset, uint64_t length,
 			if (db->db_state != DB_CACHED)
 				missed = B_TRUE;
 		}
-		dbp[i] = &db->db;
 	}
 
 	/*
@@ -1715,14 +1720,15 @@ top:
 	    (write_size >= dn->dn_datablksz)) {
 		if (zfs_dio_aligned(zfs_uio_offset(uio), write_size,
 		    dn->dn_datablksz)) {
-			return (dmu_write_uio_direct(dn, uio, size, flags, tx));
+			return (dmu_write_uio_direct(dn, uio, size,
+			    flags & ~DMU_DIRECTIO_RMW, tx));
 		} else if (write_size > dn->dn_datablksz &&
 		    zfs_dio_offset_aligned(zfs_uio_offset(uio),
 		    dn->dn_datablksz)) {
 			write_size =
 			    dn->dn_datablksz * (write_size / dn->dn_datablksz);
-			err = dmu_write_uio_direct(dn, uio, write_size, flags,
-			    tx);
+			err = dmu_write_uio_direct(dn, uio, write_size,
+			    flags & ~DMU_DIRECTIO_RMW, tx);
 			if (err == 0) {
 				size -= write_size;
 				goto top;
@@ -1734,7 +1740,26 @@ top:
 			    P2PHASE(zfs_uio_offset(uio), dn->dn_datablksz);
 		}
 	}
-	flags &= ~DMU_DIRECTIO;
+
+	/*
+	 * If allowed by the caller, the remaining part of a block is written
+	 * with Direct I/O as well, by merging it with the rest of the block.
+	 */
+	if ((flags & DMU_DIRECTIO) && (flags & DMU_DIRECTIO_RMW) &&
+	    (uio->uio_extflg & UIO_DIRECT) && dn->dn_datablkshift != 0) {
+		write_size = MIN(size, dn->dn_datablksz -
+		    P2PHASE(zfs_uio_offset(uio), dn->dn_datablksz));
+		err = dmu_write_uio_direct_rmw(dn, uio, write_size, flags, tx);
+		if (err == 0) {
+			size -= write_size;
+			if (size > 0)
+				goto top;
+			return (0);
+		} else if (err != EAGAIN) {
+			return (err);
+		}
+	}
+	flags &= ~(DMU_DIRECTIO | DMU_DIRECTIO_RMW);
 
 	err = dmu_buf_hold_array_by_dnode(dn, zfs_uio_offset(uio), write_size,
 	    FALSE, FTAG, &numbufs, &dbp, flags);
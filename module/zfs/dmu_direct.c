@@ -251,9 +251,14 @@ dmu_write_abd(dnode_t *dn, uint64_t offset, uint64_t size,
 	return (err);
 }
 
-int
-dmu_read_abd(dnode_t *dn, uint64_t offset, uint64_t size,
-    abd_t *data, dmu_flags_t flags)
+/*
+ * Issue the Direct I/O reads for the given range as children of rio.  Holes
+ * and cached blocks are copied right away.  On error, the reads issued so
+ * far are still done as part of rio.
+ */
+static int
+dmu_read_abd_impl(dnode_t *dn, uint64_t offset, uint64_t size,
+    abd_t *data, dmu_flags_t flags, zio_t *rio)
 {
 	objset_t *os = dn->dn_objset;
 	spa_t *spa = os->os_spa;
@@ -267,8 +272,6 @@ dmu_read_abd(dnode_t *dn, uint64_t offset, uint64_t size,
 	if (err)
 		return (err);
 
-	zio_t *rio = zio_root(spa, NULL, NULL, ZIO_FLAG_CANFAIL);
-
 	for (int i = 0; i < numbufs; i++) {
 		dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
 		abd_t *mbuf;
@@ -345,16 +348,79 @@ dmu_read_abd(dnode_t *dn, uint64_t offset, uint64_t size,
 		zio_nowait(cio);
 	}
 
+error:
 	dmu_buf_rele_array(dbp, numbufs, FTAG);
+	return (err);
+}
+
+int
+dmu_read_abd(dnode_t *dn, uint64_t offset, uint64_t size,
+    abd_t *data, dmu_flags_t flags)
+{
+	zio_t *rio = zio_root(dn->dn_objset->os_spa, NULL, NULL,
+	    ZIO_FLAG_CANFAIL);
 
-	return (zio_wait(rio));
+	int err = dmu_read_abd_impl(dn, offset, size, data, flags, rio);
+	int zerr = zio_wait(rio);
+
+	return (err != 0 ? err : zerr);
+}
+
+/*
+ * Like dmu_read_abd(), but for the caller to wait for, or be called back
+ * from, pio.  On error, pio must still be waited for.
+ */
+int
+dmu_read_abd_dbuf_nowait(dmu_buf_t *zdb, uint64_t offset, uint64_t size,
+    abd_t *data, dmu_flags_t flags, zio_t *pio)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)zdb;
+	int err;
+
+	DB_DNODE_ENTER(db);
+	err = dmu_read_abd_impl(DB_DNODE(db), offset, size, data, flags, pio);
+	DB_DNODE_EXIT(db);
 
-error:
-	dmu_buf_rele_array(dbp, numbufs, FTAG);
-	(void) zio_wait(rio);
 	return (err);
 }
 
+/*
+ * Read the given range into data through the ARC.  This is for retrying
+ * Direct I/O reads that failed their checksum, see zfs_read().
+ */
+int
+dmu_read_abd_dbuf_cached(dmu_buf_t *zdb, uint64_t offset, uint64_t size,
+    abd_t *data, dmu_flags_t flags)
+{
+	dmu_buf_impl_t *zdbi = (dmu_buf_impl_t *)zdb;
+	dmu_buf_t **dbp;
+	size_t aoff = 0;
+	int numbufs, err;
+
+	DB_DNODE_ENTER(zdbi);
+	err = dmu_buf_hold_array_by_dnode(DB_DNODE(zdbi), offset, size,
+	    B_TRUE, FTAG, &numbufs, &dbp, flags & ~DMU_DIRECTIO);
+	DB_DNODE_EXIT(zdbi);
+	if (err)
+		return (err);
+
+	for (int i = 0; i < numbufs; i++) {
+		dmu_buf_t *db = dbp[i];
+		uint64_t bufoff = offset - db->db_offset;
+		uint64_t tocpy = MIN(db->db_size - bufoff, size);
+
+		abd_copy_from_buf_off(data, (char *)db->db_data + bufoff,
+		    aoff, tocpy);
+
+		offset += tocpy;
+		size -= tocpy;
+		aoff += tocpy;
+	}
+	dmu_buf_rele_array(dbp, numbufs, FTAG);
+
+	return (0);
+}
+
 #ifdef _KERNEL
 int
 dmu_read_uio_direct(dnode_t *dn, zfs_uio_t *uio, uint64_t size,
@@ -399,6 +465,86 @@ dmu_write_uio_direct(dnode_t *dn, zfs_uio_t *uio, uint64_t size,
 
 	return (err);
 }
+
+/*
+ * Write part of a single block with Direct I/O.  The rest of the block is
+ * read into a transient buffer, bypassing the ARC, the user pages are
+ * merged in and the whole block is written with dmu_write_direct().  The
+ * caller must hold a range lock covering the entire block.
+ *
+ * Returns EAGAIN if the write should go through the ARC instead, either
+ * because the block already has data there or because the block could not
+ * be read back intact.
+ */
+int
+dmu_write_uio_direct_rmw(dnode_t *dn, zfs_uio_t *uio, uint64_t size,
+    dmu_flags_t flags, dmu_tx_t *tx)
+{
+	offset_t offset = zfs_uio_offset(uio);
+	offset_t page_index = (offset - zfs_uio_soffset(uio)) >> PAGESHIFT;
+	uint64_t blksz = dn->dn_datablksz;
+	uint64_t blkoff = P2ALIGN_TYPED(offset, blksz, uint64_t);
+	dmu_buf_t **dbp;
+	int numbufs, err;
+
+	ASSERT(uio->uio_extflg & UIO_DIRECT);
+	ASSERT(flags & DMU_DIRECTIO);
+	ASSERT3U(page_index, <, uio->uio_dio.npages);
+	ASSERT3U(offset + size, <=, blkoff + blksz);
+
+	err = dmu_buf_hold_array_by_dnode(dn, offset, size, B_FALSE, FTAG,
+	    &numbufs, &dbp, flags);
+	if (err)
+		return (err);
+	ASSERT3S(numbufs, ==, 1);
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[0];
+
+	/*
+	 * Cached, filling or cloned blocks are left to the ARC, where the
+	 * write is merged with the current data anyway.
+	 */
+	mutex_enter(&db->db_mtx);
+	while (db->db_state == DB_READ)
+		cv_wait(&db->db_changed, &db->db_mtx);
+	if (db->db_state != DB_UNCACHED)
+		err = SET_ERROR(EAGAIN);
+	mutex_exit(&db->db_mtx);
+	if (err) {
+		dmu_buf_rele_array(dbp, numbufs, FTAG);
+		return (err);
+	}
+
+	abd_t *data = abd_alloc_for_io(blksz, B_FALSE);
+	err = dmu_read_abd(dn, blkoff, blksz, data,
+	    flags & ~DMU_DIRECTIO_RMW);
+	if (err) {
+		/*
+		 * A Direct I/O read failing its checksum may be caused by
+		 * the user modifying the buffer; the ARC will read it again.
+		 */
+		if (err == ECKSUM)
+			err = SET_ERROR(EAGAIN);
+		abd_free(data);
+		dmu_buf_rele_array(dbp, numbufs, FTAG);
+		return (err);
+	}
+
+	abd_t *src = abd_alloc_from_pages(&uio->uio_dio.pages[page_index],
+	    offset & (PAGESIZE - 1), size);
+	abd_copy_off(data, src, offset - blkoff, 0, size);
+	abd_free(src);
+
+	/* The data buffer is freed once the write completes. */
+	zfs_racct_write(dn->dn_objset->os_spa, blksz, 1, flags);
+	err = dmu_write_direct(NULL, db, data, tx);
+
+	dmu_buf_rele_array(dbp, numbufs, FTAG);
+
+	if (err == 0)
+		zfs_uioskip(uio, size);
+
+	return (err);
+}
 #endif /* _KERNEL */
 
 EXPORT_SYMBOL(dmu_read_abd);
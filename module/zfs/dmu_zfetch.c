@@ -70,6 +70,8 @@ static unsigned int	zfetch_max_idistance = 128 * 1024 * 1024;
 static unsigned int	zfetch_max_reorder = 16 * 1024 * 1024;
 /* Max log2 fraction of holes in a stream */
 static unsigned int	zfetch_hole_shift = 2;
+/* Prefetch along strided and reverse access patterns */
+static int		zfetch_pattern = B_TRUE;
 
 typedef struct zfetch_stats {
 	kstat_named_t zfetchstat_hits;
@@ -77,6 +79,8 @@ typedef struct zfetch_stats {
 	kstat_named_t zfetchstat_stride;
 	kstat_named_t zfetchstat_past;
 	kstat_named_t zfetchstat_misses;
+	kstat_named_t zfetchstat_strided;
+	kstat_named_t zfetchstat_reverse;
 	kstat_named_t zfetchstat_max_streams;
 	kstat_named_t zfetchstat_io_issued;
 	kstat_named_t zfetchstat_io_active;
@@ -88,6 +92,8 @@ static zfetch_stats_t zfetch_stats = {
 	{ "stride",			KSTAT_DATA_UINT64 },
 	{ "past",			KSTAT_DATA_UINT64 },
 	{ "misses",			KSTAT_DATA_UINT64 },
+	{ "strided",			KSTAT_DATA_UINT64 },
+	{ "reverse",			KSTAT_DATA_UINT64 },
 	{ "max_streams",		KSTAT_DATA_UINT64 },
 	{ "io_issued",			KSTAT_DATA_UINT64 },
 	{ "io_active",			KSTAT_DATA_UINT64 },
@@ -99,6 +105,8 @@ struct {
 	wmsum_t zfetchstat_stride;
 	wmsum_t zfetchstat_past;
 	wmsum_t zfetchstat_misses;
+	wmsum_t zfetchstat_strided;
+	wmsum_t zfetchstat_reverse;
 	wmsum_t zfetchstat_max_streams;
 	wmsum_t zfetchstat_io_issued;
 	aggsum_t zfetchstat_io_active;
@@ -129,6 +137,10 @@ zfetch_kstats_update(kstat_t *ksp, int rw)
 	    wmsum_value(&zfetch_sums.zfetchstat_past);
 	zs->zfetchstat_misses.value.ui64 =
 	    wmsum_value(&zfetch_sums.zfetchstat_misses);
+	zs->zfetchstat_strided.value.ui64 =
+	    wmsum_value(&zfetch_sums.zfetchstat_strided);
+	zs->zfetchstat_reverse.value.ui64 =
+	    wmsum_value(&zfetch_sums.zfetchstat_reverse);
 	zs->zfetchstat_max_streams.value.ui64 =
 	    wmsum_value(&zfetch_sums.zfetchstat_max_streams);
 	zs->zfetchstat_io_issued.value.ui64 =
@@ -146,6 +158,8 @@ zfetch_init(void)
 	wmsum_init(&zfetch_sums.zfetchstat_stride, 0);
 	wmsum_init(&zfetch_sums.zfetchstat_past, 0);
 	wmsum_init(&zfetch_sums.zfetchstat_misses, 0);
+	wmsum_init(&zfetch_sums.zfetchstat_strided, 0);
+	wmsum_init(&zfetch_sums.zfetchstat_reverse, 0);
 	wmsum_init(&zfetch_sums.zfetchstat_max_streams, 0);
 	wmsum_init(&zfetch_sums.zfetchstat_io_issued, 0);
 	aggsum_init(&zfetch_sums.zfetchstat_io_active, 0);
@@ -174,6 +188,8 @@ zfetch_fini(void)
 	wmsum_fini(&zfetch_sums.zfetchstat_stride);
 	wmsum_fini(&zfetch_sums.zfetchstat_past);
 	wmsum_fini(&zfetch_sums.zfetchstat_misses);
+	wmsum_fini(&zfetch_sums.zfetchstat_strided);
+	wmsum_fini(&zfetch_sums.zfetchstat_reverse);
 	wmsum_fini(&zfetch_sums.zfetchstat_max_streams);
 	wmsum_fini(&zfetch_sums.zfetchstat_io_issued);
 	ASSERT0(aggsum_value(&zfetch_sums.zfetchstat_io_active));
@@ -192,6 +208,7 @@ dmu_zfetch_init(zfetch_t *zf, dnode_t *dno)
 		return;
 	zf->zf_dnode = dno;
 	zf->zf_numstreams = 0;
+	memset(&zf->zf_pattern, 0, sizeof (zf->zf_pattern));
 
 	list_create(&zf->zf_stream, sizeof (zstream_t),
 	    offsetof(zstream_t, zs_node));
@@ -231,6 +248,10 @@ dmu_zfetch_fini(zfetch_t *zf)
 	mutex_enter(&zf->zf_lock);
 	while ((zs = list_head(&zf->zf_stream)) != NULL)
 		dmu_zfetch_stream_remove(zf, zs);
+	zs = zf->zf_pattern.zp_stream;
+	if (zs != NULL && zfs_refcount_remove(&zs->zs_refs, NULL) == 0)
+		dmu_zfetch_stream_fini(zs);
+	zf->zf_pattern.zp_stream = NULL;
 	mutex_exit(&zf->zf_lock);
 	list_destroy(&zf->zf_stream);
 	mutex_destroy(&zf->zf_lock);
@@ -455,6 +476,144 @@ dmu_zfetch_future(zstream_t *zs, uint64_t blkid, uint64_t nblks)
 	return (0);
 }
 
+/*
+ * Process access for nblks blocks starting at blkid, that is not a hit for
+ * any stream.  If its start is as far from the previous one's as that one's
+ * was from its predecessor, and the accesses are not simply sequential,
+ * record the following accesses along that stride for dmu_zfetch_run() to
+ * prefetch.  The distance ramps up as for streams.
+ */
+static void
+dmu_zfetch_pattern(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
+    boolean_t fetch_data)
+{
+	zpattern_t *zp = &zf->zf_pattern;
+	int64_t s = blkid - zp->zp_blkid;
+	uint64_t next;
+
+	ASSERT(MUTEX_HELD(&zf->zf_lock));
+	zp->zp_blkid = blkid;
+	if (!zfetch_pattern || nblks == 0 || s != zp->zp_stride ||
+	    (s >= 0 && s <= nblks)) {
+		zp->zp_stride = s;
+		zp->zp_next = blkid;
+		zp->zp_dist = 0;
+		zp->zp_hits = 0;
+		return;
+	}
+	zp->zp_hits++;
+	if (s > 0)
+		ZFETCHSTAT_BUMP(zfetchstat_strided);
+	else
+		ZFETCHSTAT_BUMP(zfetchstat_reverse);
+
+	/*
+	 * Double the distance up to zfetch_min_distance, then grow it by
+	 * 1/8 up to zfetch_max_distance, as long as the pattern holds.
+	 */
+	unsigned int nbytes = nblks << zf->zf_dnode->dn_datablkshift;
+	if (zp->zp_dist < nbytes)
+		zp->zp_dist = nbytes;
+	else if (zp->zp_dist < zfetch_min_distance)
+		zp->zp_dist *= 2;
+	else
+		zp->zp_dist += zp->zp_dist / 8;
+	if (zp->zp_dist > zfetch_max_distance)
+		zp->zp_dist = MAX(zfetch_max_distance, nbytes);
+	uint_t count = zp->zp_dist / nbytes;
+
+	/* Skip the accesses we have already prefetched for. */
+	next = blkid + s;
+	int64_t done = (int64_t)(zp->zp_next - blkid) / s;
+	if (done > count)
+		return;
+	if (done > 1) {
+		next = zp->zp_next;
+		count -= done - 1;
+	}
+	zp->zp_next = next + count * s;
+
+	if (zp->zp_stream == NULL) {
+		zstream_t *zs = kmem_zalloc(sizeof (*zs), KM_SLEEP);
+		zfs_refcount_create(&zs->zs_callers);
+		zfs_refcount_create(&zs->zs_refs);
+		/* One reference for zf_pattern. */
+		zfs_refcount_add(&zs->zs_refs, NULL);
+		zp->zp_stream = zs;
+	}
+
+	/* Extend what is still pending if this continues it. */
+	if (zp->zp_pf_count > 0 && zp->zp_pf_stride == s &&
+	    zp->zp_pf_nblks == nblks && zp->zp_pf_data == fetch_data &&
+	    zp->zp_pf_blkid + zp->zp_pf_count * s == next) {
+		zp->zp_pf_count += count;
+		return;
+	}
+	zp->zp_pf_blkid = next;
+	zp->zp_pf_stride = s;
+	zp->zp_pf_nblks = nblks;
+	zp->zp_pf_count = count;
+	zp->zp_pf_data = fetch_data;
+}
+
+/*
+ * If a pattern prefetch is pending, return its stream referenced for a
+ * dmu_zfetch_run() call, as for streams returned by dmu_zfetch_prepare().
+ */
+static zstream_t *
+dmu_zfetch_pattern_hold(zfetch_t *zf)
+{
+	zstream_t *zs = zf->zf_pattern.zp_stream;
+
+	ASSERT(MUTEX_HELD(&zf->zf_lock));
+	if (zf->zf_pattern.zp_pf_count == 0)
+		return (NULL);
+	zfs_refcount_add(&zs->zs_refs, NULL);
+	zfs_refcount_add(&zs->zs_callers, NULL);
+	return (zs);
+}
+
+/*
+ * Issue the prefetch for count accesses of nblks blocks each, stride blocks
+ * apart, starting at blkid.  Without fetch_data, only the indirect blocks.
+ * Each block holds a reference on the pattern stream and is accounted in
+ * io_active until dmu_zfetch_done().
+ */
+static int
+dmu_zfetch_pattern_run(zfetch_t *zf, uint64_t blkid, int64_t stride,
+    uint64_t nblks, uint_t count, boolean_t fetch_data, boolean_t uncached)
+{
+	dnode_t *dn = zf->zf_dnode;
+	zstream_t *zs = zf->zf_pattern.zp_stream;
+	int shift = fetch_data ? 0 :
+	    dn->dn_indblkshift - SPA_BLKPTRSHIFT;
+	uint64_t b, end, pos, blocks = 0;
+	uint_t n;
+	int issued = 0;
+
+	ASSERT(RW_LOCK_HELD(&dn->dn_struct_rwlock));
+	/* Backward strides wrap around past block 0. */
+	for (n = 0, pos = blkid; n < count && pos <= dn->dn_maxblkid;
+	    n++, pos += stride) {
+		end = MIN(pos + nblks, dn->dn_maxblkid + 1);
+		blocks += ((end - 1) >> shift) - (pos >> shift) + 1;
+	}
+	if (blocks == 0)
+		return (0);
+	zfs_refcount_add_few(&zs->zs_refs, blocks, NULL);
+	aggsum_add(&zfetch_sums.zfetchstat_io_active, blocks);
+
+	for (; n > 0; n--, blkid += stride) {
+		end = MIN(blkid + nblks, dn->dn_maxblkid + 1);
+		for (b = blkid >> shift; b <= (end - 1) >> shift; b++) {
+			issued += dbuf_prefetch_impl(dn, fetch_data ? 0 : 1, b,
+			    ZIO_PRIORITY_ASYNC_READ, fetch_data && uncached ?
+			    ARC_FLAG_UNCACHED : 0, dmu_zfetch_done, zs);
+		}
+	}
+	return (issued);
+}
+
 /*
  * Prime a zfetch stream at blkid, so that the first demand access triggered
  * enough prefetch without ramp-up to sequentially read up to end_blkid.
@@ -533,6 +692,7 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 	spa_t *spa = zf->zf_dnode->dn_objset->os_spa;
 	zfs_prefetch_type_t os_prefetch = zf->zf_dnode->dn_objset->os_prefetch;
 	int64_t ipf_start, ipf_end;
+	uint64_t pat_nblks = nblks;
 
 	if (zfs_prefetch_disable || os_prefetch == ZFS_PREFETCH_NONE)
 		return (NULL);
@@ -611,10 +771,13 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 					goto future;
 				}
 				nblks = dmu_zfetch_future(zs, blkid, nblks);
-				if (nblks > 0)
+				if (nblks > 0) {
 					ZFETCHSTAT_BUMP(zfetchstat_stride);
-				else
+				} else {
 					ZFETCHSTAT_BUMP(zfetchstat_future);
+					dmu_zfetch_pattern(zf, blkid,
+					    pat_nblks, fetch_data);
+				}
 				goto future;
 			}
 		} else if (end_blkid >= zs->zs_blkid) {
@@ -625,6 +788,7 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 		    (int)(zs->zs_atime - t) >= 0) {
 			ZFETCHSTAT_BUMP(zfetchstat_past);
 			zs->zs_atime = gethrestime_sec();
+			dmu_zfetch_pattern(zf, blkid, pat_nblks, fetch_data);
 			goto out;
 		}
 	}
@@ -636,6 +800,8 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 	ASSERT0P(zs);
 	if (end_blkid < maxblkid)
 		(void) dmu_zfetch_stream_create(zf, end_blkid);
+	dmu_zfetch_pattern(zf, blkid, pat_nblks, fetch_data);
+	zs = dmu_zfetch_pattern_hold(zf);
 	mutex_exit(&zf->zf_lock);
 	ZFETCHSTAT_BUMP(zfetchstat_misses);
 	ipf_start = 0;
@@ -657,10 +823,11 @@ future:
 	if (end_blkid >= maxblkid) {
 		dmu_zfetch_stream_remove(zf, zs);
 out:
+		zs = dmu_zfetch_pattern_hold(zf);
 		mutex_exit(&zf->zf_lock);
 		if (!have_lock)
 			rw_exit(&zf->zf_dnode->dn_struct_rwlock);
-		return (NULL);
+		return (zs);
 	}
 
 	/*
@@ -753,7 +920,12 @@ void
 dmu_zfetch_run(zfetch_t *zf, zstream_t *zs, boolean_t missed,
     boolean_t have_lock, boolean_t uncached)
 {
+	zpattern_t *zp = &zf->zf_pattern;
 	int64_t pf_start, pf_end, ipf_start, ipf_end;
+	uint64_t pat_blkid, pat_nblks;
+	int64_t pat_stride;
+	uint_t pat_count;
+	boolean_t pat_data;
 	int epbs, issued;
 
 	if (missed)
@@ -780,6 +952,13 @@ dmu_zfetch_run(zfetch_t *zf, zstream_t *zs, boolean_t missed,
 	}
 	ipf_start = zs->zs_ipf_start;
 	ipf_end = zs->zs_ipf_start = zs->zs_ipf_end;
+	/* Whichever stream is run also takes the pending pattern prefetch. */
+	pat_blkid = zp->zp_pf_blkid;
+	pat_stride = zp->zp_pf_stride;
+	pat_nblks = zp->zp_pf_nblks;
+	pat_count = zp->zp_pf_count;
+	pat_data = zp->zp_pf_data;
+	zp->zp_pf_count = 0;
 	mutex_exit(&zf->zf_lock);
 	ASSERT3S(pf_start, <=, pf_end);
 	ASSERT3S(ipf_start, <=, ipf_end);
@@ -796,9 +975,11 @@ dmu_zfetch_run(zfetch_t *zf, zstream_t *zs, boolean_t missed,
 		/* Some other thread has done our work, so drop the ref. */
 		if (zfs_refcount_remove(&zs->zs_refs, NULL) == 0)
 			dmu_zfetch_stream_fini(zs);
-		return;
+		if (pat_count == 0)
+			return;
 	}
-	aggsum_add(&zfetch_sums.zfetchstat_io_active, issued);
+	if (issued)
+		aggsum_add(&zfetch_sums.zfetchstat_io_active, issued);
 
 	if (!have_lock)
 		rw_enter(&zf->zf_dnode->dn_struct_rwlock, RW_READER);
@@ -813,6 +994,10 @@ dmu_zfetch_run(zfetch_t *zf, zstream_t *zs, boolean_t missed,
 		issued += dbuf_prefetch_impl(zf->zf_dnode, 1, iblk,
 		    ZIO_PRIORITY_ASYNC_READ, 0, dmu_zfetch_done, zs);
 	}
+	if (pat_count > 0) {
+		issued += dmu_zfetch_pattern_run(zf, pat_blkid, pat_stride,
+		    pat_nblks, pat_count, pat_data, uncached);
+	}
 
 	if (!have_lock)
 		rw_exit(&zf->zf_dnode->dn_struct_rwlock);
@@ -858,3 +1043,6 @@ ZFS_MODULE_PARAM(zfs_prefetch, zfetch_, max_reorder, UINT, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs_prefetch, zfetch_, hole_shift, UINT, ZMOD_RW,
 	"Max log2 fraction of holes in a stream");
+
+ZFS_MODULE_PARAM(zfs_prefetch, zfetch_, pattern, INT, ZMOD_RW,
+	"Prefetch along strided and reverse access patterns");
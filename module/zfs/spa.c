@@ -208,6 +208,23 @@ static uint_t metaslab_preload_pct = 50;
 static uint_t	zio_taskq_batch_pct = 80;	  /* 1 thread per cpu in pset */
 static uint_t	zio_taskq_batch_tpq;		  /* threads per taskq */
 
+/*
+ * When set, the taskqs of I/O types with more than one worker thread are
+ * split across the NUMA nodes, with their threads bound to the CPUs of
+ * their node.  Each zio is then processed by the taskqs of the node of the
+ * CPU that issued it.
+ */
+static uint_t	zio_taskq_numa = 0;
+
+/*
+ * NUMA node ids may be sparse and some nodes may have memory but no CPUs.
+ * spa_numa_init() gives the first SPA_TASKQ_NODES_MAX nodes with CPUs the
+ * dense indexes 0 to spa_taskq_nnodes - 1, which the taskqs are split by.
+ */
+static uint_t	spa_taskq_nnodes = 1;
+static int	spa_taskq_node_ids[SPA_TASKQ_NODES_MAX];  /* index to node */
+static uint8_t	*spa_taskq_node_idx;	/* node to index, UINT8_MAX if none */
+
 #ifdef HAVE_SYSDC
 static const boolean_t	zio_taskq_sysdc = B_TRUE; /* use SDC scheduling class */
 static const uint_t	zio_taskq_basedc = 80;	  /* base duty cycle */
@@ -1210,6 +1227,68 @@ spa_get_errlists(spa_t *spa, avl_tree_t *last, avl_tree_t *scrub)
 	    offsetof(spa_error_entry_t, se_avl));
 }
 
+void
+spa_numa_init(void)
+{
+	uint_t n = 0;
+
+	if (!zio_taskq_numa || max_nnodes <= 1)
+		return;
+
+	spa_taskq_node_idx = kmem_alloc(max_nnodes, KM_SLEEP);
+	memset(spa_taskq_node_idx, UINT8_MAX, max_nnodes);
+	for (int node = 0; node < (int)max_nnodes; node++) {
+		if (n < SPA_TASKQ_NODES_MAX && node_has_cpus(node)) {
+			spa_taskq_node_ids[n] = node;
+			spa_taskq_node_idx[node] = n++;
+		}
+	}
+	spa_taskq_nnodes = MAX(n, 1);
+}
+
+void
+spa_numa_fini(void)
+{
+	if (spa_taskq_node_idx != NULL) {
+		kmem_free(spa_taskq_node_idx, max_nnodes);
+		spa_taskq_node_idx = NULL;
+	}
+	spa_taskq_nnodes = 1;
+}
+
+/*
+ * Number of NUMA nodes the zio taskqs are split across.
+ */
+uint_t
+spa_taskq_nodes(void)
+{
+	return (spa_taskq_nnodes);
+}
+
+/*
+ * NUMA node id of the given node index.
+ */
+int
+spa_taskq_node_id(uint_t index)
+{
+	ASSERT3U(index, <, spa_taskq_nnodes);
+	return (spa_taskq_nnodes > 1 ? spa_taskq_node_ids[index] : 0);
+}
+
+/*
+ * Index of the given NUMA node.  Nodes that had no CPUs at load time, or
+ * that are past SPA_TASKQ_NODES_MAX, are spread over the indexes.
+ */
+static uint_t
+spa_taskq_node_index(int node)
+{
+	if (spa_taskq_nnodes > 1 && node >= 0 && node < (int)max_nnodes &&
+	    spa_taskq_node_idx[node] != UINT8_MAX)
+		return (spa_taskq_node_idx[node]);
+
+	return ((uint_t)node % spa_taskq_nnodes);
+}
+
 static void
 spa_taskqs_init(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 {
@@ -1219,10 +1298,16 @@ spa_taskqs_init(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 	uint_t count = ztip->zti_count;
 	spa_taskqs_t *tqs = &spa->spa_zio_taskq[t][q];
 	uint_t cpus, threads, flags = TASKQ_DYNAMIC;
+	uint_t nodes = spa_taskq_nnodes;
 
 	switch (mode) {
 	case ZTI_MODE_FIXED:
 		ASSERT3U(value, >, 0);
+		/* Spread the threads of a single taskq over the nodes. */
+		if (nodes > 1 && count == 1 && value > 1) {
+			count = nodes;
+			value = (value + nodes - 1) / nodes;
+		}
 		break;
 
 	case ZTI_MODE_SYNC:
@@ -1281,6 +1366,7 @@ spa_taskqs_init(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 			while (count * count > cpus)
 				count--;
 		}
+		count = roundup(count, nodes);
 
 		/*
 		 * Try to represent the number of threads per taskq as percent
@@ -1297,6 +1383,7 @@ spa_taskqs_init(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 
 	case ZTI_MODE_NULL:
 		tqs->stqs_count = 0;
+		tqs->stqs_nodes = 1;
 		tqs->stqs_taskq = NULL;
 		return;
 
@@ -1307,8 +1394,13 @@ spa_taskqs_init(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 		break;
 	}
 
+	/* Write issue taskqs are bound to allocators instead. */
+	if (mode == ZTI_MODE_SYNC || count % nodes != 0)
+		nodes = 1;
+
 	ASSERT3U(count, >, 0);
 	tqs->stqs_count = count;
+	tqs->stqs_nodes = nodes;
 	tqs->stqs_taskq = kmem_alloc(count * sizeof (taskq_t *), KM_SLEEP);
 
 	for (uint_t i = 0; i < count; i++) {
@@ -1337,8 +1429,14 @@ spa_taskqs_init(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 			const pri_t pri = (t == ZIO_TYPE_WRITE &&
 			    q == ZIO_TASKQ_ISSUE) ?
 			    wtqclsyspri : maxclsyspri;
-			tq = taskq_create_proc(name, value, pri, 50,
-			    INT_MAX, spa->spa_proc, flags);
+			if (nodes > 1) {
+				tq = taskq_create_node(name, value, pri, 50,
+				    INT_MAX, flags,
+				    spa_taskq_node_ids[i % nodes]);
+			} else {
+				tq = taskq_create_proc(name, value, pri, 50,
+				    INT_MAX, spa->spa_proc, flags);
+			}
 #ifdef HAVE_SYSDC
 		}
 #endif
@@ -1718,6 +1816,17 @@ spa_taskq_dispatch(spa_t *spa, zio_type_t t, zio_taskq_type_t q,
 	} else if ((t == ZIO_TYPE_WRITE) && (q == ZIO_TASKQ_ISSUE) &&
 	    ZIO_HAS_ALLOCATOR(zio)) {
 		tq = tqs->stqs_taskq[zio->io_allocator % tqs->stqs_count];
+	} else if (tqs->stqs_nodes > 1) {
+		/*
+		 * Taskq i runs on the node of index i % stqs_nodes.  Pick one
+		 * of those of the node the zio was issued on.
+		 */
+		uint_t node = spa_taskq_node_index(zio->io_node);
+		uint_t per_node = tqs->stqs_count / tqs->stqs_nodes;
+		tq = tqs->stqs_taskq[node + tqs->stqs_nodes *
+		    (((uint64_t)gethrtime()) % per_node)];
+		spa_taskq_node_add(spa, node,
+		    node != spa_taskq_node_index(CPU_NODEID));
 	} else {
 		tq = tqs->stqs_taskq[((uint64_t)gethrtime()) % tqs->stqs_count];
 	}
@@ -2194,6 +2303,10 @@ spa_destroy_aux_threads(spa_t *spa)
 		zthr_destroy(spa->spa_raidz_expand_zthr);
 		spa->spa_raidz_expand_zthr = NULL;
 	}
+	if (spa->spa_arc_warm_zthr != NULL) {
+		zthr_destroy(spa->spa_arc_warm_zthr);
+		spa->spa_arc_warm_zthr = NULL;
+	}
 }
 
 static void
@@ -2311,6 +2424,27 @@ spa_should_sync_time_logger_on_unload(spa_t *spa)
 	return (B_TRUE);
 }
 
+/*
+ * The ARC warm-start list is saved when the pool is exported and when it
+ * is unloaded while still active, as happens at shutdown.
+ */
+static boolean_t
+spa_should_save_arc_warm_on_unload(spa_t *spa)
+{
+
+	if (!spa_writeable(spa) || spa_suspended(spa))
+		return (B_FALSE);
+
+	if (!spa->spa_sync_on)
+		return (B_FALSE);
+
+	if (spa_state(spa) != POOL_STATE_EXPORTED &&
+	    spa_state(spa) != POOL_STATE_ACTIVE)
+		return (B_FALSE);
+
+	return (B_TRUE);
+}
+
 
 /*
  * Opposite of spa_load().
@@ -2336,6 +2470,9 @@ spa_unload(spa_t *spa)
 		if (spa_should_sync_time_logger_on_unload(spa))
 			spa_unload_sync_time_logger(spa);
 
+		if (spa_should_save_arc_warm_on_unload(spa))
+			arc_warm_save(spa);
+
 		/*
 		 * If the log space map feature is enabled and the pool is
 		 * getting exported (but not destroyed), we want to spend some
@@ -2427,6 +2564,7 @@ spa_unload(spa_t *spa)
 	ddt_unload(spa);
 	brt_unload(spa);
 	spa_unload_log_sm_metadata(spa);
+	arc_warm_fini(spa);
 
 	/*
 	 * Drop and purge level 2 cache
@@ -3624,6 +3762,8 @@ spa_spawn_aux_threads(spa_t *spa)
 	    zthr_create("z_checkpoint_discard",
 	    spa_checkpoint_discard_thread_check,
 	    spa_checkpoint_discard_thread, spa, minclsyspri);
+
+	arc_warm_start(spa);
 }
 
 /*
@@ -7845,6 +7985,9 @@ spa_export_common(const char *pool, int new_state, nvlist_t **oldconfig,
 		if (spa_should_sync_time_logger_on_unload(spa))
 			spa_unload_sync_time_logger(spa);
 
+		if (!hardforce && spa_should_save_arc_warm_on_unload(spa))
+			arc_warm_save(spa);
+
 		/*
 		 * If the log space map feature is enabled and the pool is
 		 * getting exported (but not destroyed), we want to spend some
@@ -10007,6 +10150,10 @@ spa_async_suspend(spa_t *spa)
 	zthr_t *ll_condense_thread = spa->spa_livelist_condense_zthr;
 	if (ll_condense_thread != NULL)
 		zthr_cancel(ll_condense_thread);
+
+	zthr_t *arc_warm_thread = spa->spa_arc_warm_zthr;
+	if (arc_warm_thread != NULL)
+		zthr_cancel(arc_warm_thread);
 }
 
 void
@@ -10037,6 +10184,10 @@ spa_async_resume(spa_t *spa)
 	zthr_t *ll_condense_thread = spa->spa_livelist_condense_zthr;
 	if (ll_condense_thread != NULL)
 		zthr_resume(ll_condense_thread);
+
+	zthr_t *arc_warm_thread = spa->spa_arc_warm_zthr;
+	if (arc_warm_thread != NULL)
+		zthr_resume(arc_warm_thread);
 }
 
 static boolean_t
@@ -12023,6 +12174,9 @@ ZFS_MODULE_VIRTUAL_PARAM_CALL(zfs_zio, zio_, taskq_free,
 ZFS_MODULE_PARAM(zfs_zio, zio_, taskq_write_tpq, UINT, ZMOD_RW,
 	"Number of CPUs per write issue taskq");
 
+ZFS_MODULE_PARAM(zfs_zio, zio_, taskq_numa, UINT, ZMOD_RD,
+	"Process each zio on the NUMA node of the CPU that issued it");
+
 ZFS_MODULE_PARAM(zfs, zfs_, ccw_retry_interval, INT, ZMOD_RW,
 	"Configuration cache file write, retry after failure, interval "
 	"(seconds)");
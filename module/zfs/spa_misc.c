@@ -769,6 +769,7 @@ spa_add(const char *name, nvlist_t *config, const char *altroot)
 	mutex_init(&spa->spa_flushed_ms_lock, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&spa->spa_activities_lock, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&spa->spa_txg_log_time_lock, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&spa->spa_arc_warm_lock, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&spa->spa_condense_stats_lock, NULL, MUTEX_DEFAULT, NULL);
 
 	cv_init(&spa->spa_async_cv, NULL, CV_DEFAULT, NULL);
@@ -962,6 +963,7 @@ spa_remove(spa_t *spa)
 	mutex_destroy(&spa->spa_feat_stats_lock);
 	mutex_destroy(&spa->spa_activities_lock);
 	mutex_destroy(&spa->spa_txg_log_time_lock);
+	mutex_destroy(&spa->spa_arc_warm_lock);
 	mutex_destroy(&spa->spa_condense_stats_lock);
 
 	kmem_free(spa, sizeof (spa_t));
@@ -2646,6 +2648,7 @@ spa_init(spa_mode_t mode)
 	    offsetof(spa_aux_t, aux_avl));
 
 	spa_mode_global = mode;
+	spa_numa_init();
 
 #ifndef _KERNEL
 	if (spa_mode_global != SPA_MODE_READ && dprintf_find_string("watch")) {
@@ -2711,6 +2714,7 @@ spa_fini(void)
 	qat_fini();
 	spa_import_progress_destroy();
 	zap_fini();
+	spa_numa_fini();
 
 	avl_destroy(&spa_namespace_avl);
 	avl_destroy(&spa_spare_avl);
@@ -554,6 +554,113 @@ spa_tx_assign_add_nsecs(spa_t *spa, uint64_t nsecs)
 	atomic_inc_64(&((kstat_named_t *)shk->priv)[idx].value.ui64);
 }
 
+/*
+ * ==========================================================================
+ * SPA zio taskq NUMA node Routines
+ * ==========================================================================
+ */
+
+/*
+ * For each NUMA node, the number of zio pipeline stages dispatched to its
+ * taskqs, and how many of those were dispatched from a CPU of another node
+ * (usually I/O completions).  Only counted while zio_taskq_numa is set.
+ * priv holds a pair of wmsum_t per node.
+ */
+static int
+spa_taskq_nodes_update(kstat_t *ksp, int rw)
+{
+	spa_t *spa = ksp->ks_private;
+	spa_history_kstat_t *shk = &spa->spa_stats.taskq_nodes;
+	wmsum_t *sums = shk->priv;
+	kstat_named_t *ks = ksp->ks_data;
+
+	if (rw == KSTAT_WRITE)
+		return (SET_ERROR(EACCES));
+
+	for (int i = 0; i < shk->count * 2; i++)
+		ks[i].value.ui64 = wmsum_value(&sums[i]);
+
+	return (0);
+}
+
+static void
+spa_taskq_nodes_init(spa_t *spa)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.taskq_nodes;
+
+	mutex_init(&shk->lock, NULL, MUTEX_DEFAULT, NULL);
+
+	shk->count = 0;
+	shk->kstat = NULL;
+	if (spa_taskq_nodes() <= 1)
+		return;
+
+	shk->count = spa_taskq_nodes();
+	shk->size = shk->count * 2 * sizeof (kstat_named_t);
+	shk->priv = kmem_alloc(shk->count * 2 * sizeof (wmsum_t), KM_SLEEP);
+	for (int i = 0; i < shk->count * 2; i++)
+		wmsum_init(&((wmsum_t *)shk->priv)[i], 0);
+
+	char *name = kmem_asprintf("zfs/%s", spa_name(spa));
+	kstat_t *ksp = kstat_create(name, 0, "zio_taskq_nodes", "misc",
+	    KSTAT_TYPE_NAMED, 0, KSTAT_FLAG_VIRTUAL);
+
+	shk->kstat = ksp;
+	if (ksp) {
+		kstat_named_t *ks = kmem_zalloc(shk->size, KM_SLEEP);
+		for (int i = 0; i < shk->count; i++) {
+			ks[2 * i].data_type = KSTAT_DATA_UINT64;
+			(void) snprintf(ks[2 * i].name, KSTAT_STRLEN,
+			    "node%d_dispatched", spa_taskq_node_id(i));
+			ks[2 * i + 1].data_type = KSTAT_DATA_UINT64;
+			(void) snprintf(ks[2 * i + 1].name, KSTAT_STRLEN,
+			    "node%d_remote", spa_taskq_node_id(i));
+		}
+		ksp->ks_lock = &shk->lock;
+		ksp->ks_data = ks;
+		ksp->ks_ndata = shk->count * 2;
+		ksp->ks_data_size = shk->size;
+		ksp->ks_private = spa;
+		ksp->ks_update = spa_taskq_nodes_update;
+		kstat_install(ksp);
+	}
+
+	kmem_strfree(name);
+}
+
+static void
+spa_taskq_nodes_destroy(spa_t *spa)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.taskq_nodes;
+	kstat_t *ksp = shk->kstat;
+
+	if (ksp) {
+		kmem_free(ksp->ks_data, shk->size);
+		kstat_delete(ksp);
+	}
+	if (shk->count != 0) {
+		for (int i = 0; i < shk->count * 2; i++)
+			wmsum_fini(&((wmsum_t *)shk->priv)[i]);
+		kmem_free(shk->priv, shk->count * 2 * sizeof (wmsum_t));
+	}
+
+	mutex_destroy(&shk->lock);
+}
+
+void
+spa_taskq_node_add(spa_t *spa, uint_t node, boolean_t remote)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.taskq_nodes;
+	wmsum_t *sums = shk->priv;
+
+	if (node >= shk->count)
+		return;
+
+	wmsum_add(&sums[2 * node], 1);
+	if (remote)
+		wmsum_add(&sums[2 * node + 1], 1);
+}
+
 /*
  * ==========================================================================
  * SPA MMP History Routines
@@ -882,6 +989,95 @@ spa_guid_destroy(spa_t *spa)
 	mutex_destroy(&shk->lock);
 }
 
+static int
+spa_vdev_queue_headers(char *buf, size_t size)
+{
+	(void) snprintf(buf, size, "%-20s %-10s %-10s %-10s %-8s %-8s %-8s "
+	    "%-8s %-8s %-8s %-8s\n", "vdev_guid", "target_us", "wait_us",
+	    "svc_us", "async_r", "async_w", "scrub", "removal", "init",
+	    "trim", "rebuild");
+	return (0);
+}
+
+static int
+spa_vdev_queue_data(char *buf, size_t size, void *data)
+{
+	spa_t *spa = (spa_t *)data;
+	int error = 0;
+
+	buf[0] = '\0';
+
+	spa_config_enter(spa, SCL_VDEV, FTAG, RW_READER);
+	for (vdev_t *vd = list_head(&spa->spa_leaf_list); vd != NULL;
+	    vd = list_next(&spa->spa_leaf_list, vd)) {
+		vdev_queue_t *vq = &vd->vdev_queue;
+		size_t len = strlen(buf);
+
+		if (snprintf(buf + len, size - len, "%-20llu %-10u %-10llu "
+		    "%-10llu %-8u %-8u %-8u %-8u %-8u %-8u %-8u\n",
+		    (u_longlong_t)vd->vdev_guid, zfs_vdev_sync_read_target_us,
+		    (u_longlong_t)NSEC2USEC(
+		    vq->vq_lt_wait[ZIO_PRIORITY_SYNC_READ]),
+		    (u_longlong_t)NSEC2USEC(
+		    vq->vq_lt_service[ZIO_PRIORITY_SYNC_READ]),
+		    vdev_queue_class_limit(vd, ZIO_PRIORITY_ASYNC_READ),
+		    vdev_queue_class_limit(vd, ZIO_PRIORITY_ASYNC_WRITE),
+		    vdev_queue_class_limit(vd, ZIO_PRIORITY_SCRUB),
+		    vdev_queue_class_limit(vd, ZIO_PRIORITY_REMOVAL),
+		    vdev_queue_class_limit(vd, ZIO_PRIORITY_INITIALIZING),
+		    vdev_queue_class_limit(vd, ZIO_PRIORITY_TRIM),
+		    vdev_queue_class_limit(vd, ZIO_PRIORITY_REBUILD)) >=
+		    size - len) {
+			error = SET_ERROR(ENOMEM);
+			break;
+		}
+	}
+	spa_config_exit(spa, SCL_VDEV, FTAG);
+
+	return (error);
+}
+
+/*
+ * Return the per-leaf sync read latency target state and resulting class
+ * limits in /proc/spl/kstat/zfs/<pool>/vdev_queue.
+ */
+static void
+spa_vdev_queue_init(spa_t *spa)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.vdev_queue;
+	char *name;
+	kstat_t *ksp;
+
+	mutex_init(&shk->lock, NULL, MUTEX_DEFAULT, NULL);
+
+	name = kmem_asprintf("zfs/%s", spa_name(spa));
+	ksp = kstat_create(name, 0, "vdev_queue", "misc",
+	    KSTAT_TYPE_RAW, 0, KSTAT_FLAG_VIRTUAL);
+
+	shk->kstat = ksp;
+	if (ksp) {
+		ksp->ks_lock = &shk->lock;
+		ksp->ks_data = NULL;
+		ksp->ks_private = spa;
+		kstat_set_raw_ops(ksp, spa_vdev_queue_headers,
+		    spa_vdev_queue_data, spa_state_addr);
+		kstat_install(ksp);
+	}
+
+	kmem_strfree(name);
+}
+
+static void
+spa_vdev_queue_destroy(spa_t *spa)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.vdev_queue;
+	kstat_t *ksp = shk->kstat;
+	if (ksp)
+		kstat_delete(ksp);
+
+	mutex_destroy(&shk->lock);
+}
+
 static const spa_iostats_t spa_iostats_template = {
 	{ "trim_extents_written",		KSTAT_DATA_UINT64 },
 	{ "trim_bytes_written",			KSTAT_DATA_UINT64 },
@@ -909,6 +1105,10 @@ static const spa_iostats_t spa_iostats_template = {
 	{ "direct_read_bytes",			KSTAT_DATA_UINT64 },
 	{ "direct_write_count",			KSTAT_DATA_UINT64 },
 	{ "direct_write_bytes",			KSTAT_DATA_UINT64 },
+	{ "direct_rmw_count",			KSTAT_DATA_UINT64 },
+	{ "arc_warm_blocks",			KSTAT_DATA_UINT64 },
+	{ "arc_warm_issued",			KSTAT_DATA_UINT64 },
+	{ "arc_warm_skipped",			KSTAT_DATA_UINT64 },
 };
 
 #define	SPA_IOSTATS_ADD(stat, val) \
@@ -986,12 +1186,30 @@ spa_iostats_write_add(spa_t *spa, uint64_t size, uint64_t iops,
 	if (flags & DMU_DIRECTIO) {
 		SPA_IOSTATS_ADD(direct_write_count, iops);
 		SPA_IOSTATS_ADD(direct_write_bytes, size);
+		if (flags & DMU_DIRECTIO_RMW)
+			SPA_IOSTATS_ADD(direct_rmw_count, iops);
 	} else {
 		SPA_IOSTATS_ADD(arc_write_count, iops);
 		SPA_IOSTATS_ADD(arc_write_bytes, size);
 	}
 }
 
+void
+spa_iostats_arc_warm_add(spa_t *spa, uint64_t blocks, uint64_t issued,
+    uint64_t skipped)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.iostats;
+	kstat_t *ksp = shk->kstat;
+
+	if (ksp == NULL)
+		return;
+
+	spa_iostats_t *iostats = ksp->ks_data;
+	SPA_IOSTATS_ADD(arc_warm_blocks, blocks);
+	SPA_IOSTATS_ADD(arc_warm_issued, issued);
+	SPA_IOSTATS_ADD(arc_warm_skipped, skipped);
+}
+
 static int
 spa_iostats_update(kstat_t *ksp, int rw)
 {
@@ -1133,11 +1351,15 @@ spa_stats_init(spa_t *spa)
 	spa_guid_init(spa);
 	spa_iostats_init(spa);
 	spa_log_sm_stats_init(spa);
+	spa_taskq_nodes_init(spa);
+	spa_vdev_queue_init(spa);
 }
 
 void
 spa_stats_destroy(spa_t *spa)
 {
+	spa_vdev_queue_destroy(spa);
+	spa_taskq_nodes_destroy(spa);
 	spa_log_sm_stats_destroy(spa);
 	spa_iostats_destroy(spa);
 	spa_health_destroy(spa);
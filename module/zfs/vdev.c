@@ -163,7 +163,8 @@ uint_t zfs_vdev_min_auto_ashift = ASHIFT_MIN;
 /*
  * VDEV checksum verification for Direct I/O writes. This is neccessary for
  * Linux, because anonymous pages can not be placed under write protection
- * during Direct I/O writes.
+ * during Direct I/O writes.  Writes whose data was compressed or encrypted
+ * into a separate buffer are never verified, see zio_vdev_child_io().
  */
 #if !defined(__FreeBSD__)
 uint_t zfs_vdev_direct_write_verify = 1;
@@ -773,6 +774,7 @@ vdev_alloc_common(spa_t *spa, uint_t id, uint64_t guid, vdev_ops_t *ops)
 	vd->vdev_slow_io_t = vdev_prop_default_numeric(VDEV_PROP_SLOW_IO_T);
 
 	vd->vdev_scheduler = vdev_prop_default_numeric(VDEV_PROP_SCHEDULER);
+	vd->vdev_poll = vdev_prop_default_numeric(VDEV_PROP_POLL);
 
 	list_link_init(&vd->vdev_config_dirty_node);
 	list_link_init(&vd->vdev_state_dirty_node);
@@ -4035,6 +4037,12 @@ vdev_load(vdev_t *vd)
 		if (error && error != ENOENT)
 			vdev_dbgmsg(vd, "vdev_load: zap_lookup(zap=%llu) "
 			    "failed [error=%d]", (u_longlong_t)zapobj, error);
+
+		error = vdev_prop_get_bool(vd, VDEV_PROP_POLL,
+		    &vd->vdev_poll);
+		if (error && error != ENOENT)
+			vdev_dbgmsg(vd, "vdev_load: zap_lookup(zap=%llu) "
+			    "failed [error=%d]", (u_longlong_t)zapobj, error);
 	}
 
 	/*
@@ -4918,6 +4926,9 @@ vdev_get_child_stat_ex(vdev_t *cvd, vdev_stat_ex_t *vsx, vdev_stat_ex_t *cvsx)
 		for (b = 0; b < ARRAY_SIZE(vsx->vsx_disk_histo[0]); b++)
 			vsx->vsx_disk_histo[t][b] += cvsx->vsx_disk_histo[t][b];
 
+		for (b = 0; b < ARRAY_SIZE(vsx->vsx_poll_histo[0]); b++)
+			vsx->vsx_poll_histo[t][b] += cvsx->vsx_poll_histo[t][b];
+
 		for (b = 0; b < ARRAY_SIZE(vsx->vsx_total_histo[0]); b++) {
 			vsx->vsx_total_histo[t][b] +=
 			    cvsx->vsx_total_histo[t][b];
@@ -5141,7 +5152,7 @@ vdev_stat_update(zio_t *zio, uint64_t psize)
 	vdev_stat_ex_t *vsx = &vd->vdev_stat_ex;
 #endif
 	zio_type_t type = zio->io_type;
-	int flags = zio->io_flags;
+	zio_flag_t flags = zio->io_flags;
 
 	/*
 	 * If this i/o is a gang leader, it didn't do any actual work.
@@ -5267,6 +5278,10 @@ vdev_stat_update(zio_t *zio, uint64_t psize)
 				    [L_HISTO(zio->io_delta - zio->io_delay)]++;
 				vsx->vsx_disk_histo[type]
 				    [L_HISTO(zio->io_delay)]++;
+				if (flags & ZIO_FLAG_POLLED) {
+					vsx->vsx_poll_histo[type]
+					    [L_HISTO(zio->io_delay)]++;
+				}
 				vsx->vsx_total_histo[type]
 				    [L_HISTO(zio->io_delta)]++;
 			}
@@ -6427,6 +6442,13 @@ vdev_prop_set(spa_t *spa, nvlist_t *innvl, nvlist_t *outnvl)
 			}
 			vd->vdev_scheduler = intval;
 			break;
+		case VDEV_PROP_POLL:
+			if (nvpair_value_uint64(elem, &intval) != 0) {
+				error = EINVAL;
+				break;
+			}
+			vd->vdev_poll = intval != 0;
+			break;
 		case VDEV_PROP_ALLOC_BIAS:
 			if (nvpair_value_uint64(elem, &intval) != 0) {
 				error = EINVAL;
@@ -6922,6 +6944,7 @@ vdev_prop_get(spa_t *spa, nvlist_t *innvl, nvlist_t *outnvl)
 				break;
 
 			case VDEV_PROP_SLOW_IO_EVENTS:
+			case VDEV_PROP_POLL:
 				err = vdev_prop_get_bool(vd, prop, &boolval);
 				if (err && err != ENOENT)
 					break;
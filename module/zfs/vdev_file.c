@@ -239,7 +239,8 @@ vdev_file_io_strategy(void *arg)
 	if (resid != 0 && zio->io_error == 0)
 		zio->io_error = SET_ERROR(ENOSPC);
 
-	zio_delay_interrupt(zio);
+	if (zio->io_target_timestamp != 0 || !zio_inline_complete(zio))
+		zio_delay_interrupt(zio);
 }
 
 static void
@@ -302,6 +302,14 @@ vdev_config_generate_stats(vdev_t *vd, nvlist_t *nv)
 	    vsx->vsx_disk_histo[ZIO_TYPE_WRITE],
 	    ARRAY_SIZE(vsx->vsx_disk_histo[ZIO_TYPE_WRITE]));
 
+	fnvlist_add_uint64_array(nvx, ZPOOL_CONFIG_VDEV_POLL_R_LAT_HISTO,
+	    vsx->vsx_poll_histo[ZIO_TYPE_READ],
+	    ARRAY_SIZE(vsx->vsx_poll_histo[ZIO_TYPE_READ]));
+
+	fnvlist_add_uint64_array(nvx, ZPOOL_CONFIG_VDEV_POLL_W_LAT_HISTO,
+	    vsx->vsx_poll_histo[ZIO_TYPE_WRITE],
+	    ARRAY_SIZE(vsx->vsx_poll_histo[ZIO_TYPE_WRITE]));
+
 	fnvlist_add_uint64_array(nvx, ZPOOL_CONFIG_VDEV_SYNC_R_LAT_HISTO,
 	    vsx->vsx_queue_histo[ZIO_PRIORITY_SYNC_READ],
 	    ARRAY_SIZE(vsx->vsx_queue_histo[ZIO_PRIORITY_SYNC_READ]));
@@ -116,6 +116,27 @@
  * maximum percentage, this indicates that the rate of incoming data is
  * greater than the rate that the backend storage can handle. In this case, we
  * must further throttle incoming writes (see dmu_tx_delay() for details).
+ *
+ * Sync Read Latency Target
+ *
+ * Optionally (zfs_vdev_sync_read_target_us), each leaf queue measures how
+ * many sync reads take longer than a target to complete, counting from when
+ * they were queued, and caps the min and max active of every class other than
+ * sync read and sync write so that at most 1% of them do.  When the target is
+ * missed, the caps of the classes that had I/O active as the late reads
+ * completed are cut in half; the others are left alone.  The caps are
+ * relaxed one I/O at a time while no read is late, and lifted once a window
+ * passes without sync reads, see vdev_queue_lt_update().
+ *
+ * Elevator
+ *
+ * With zfs_vdev_elevator set, rotating leaf vdevs still serve the class
+ * minimums as above, but once those are met the next I/O is the first one at
+ * or after the last issued offset among all classes under their maximum,
+ * wrapping around to the lowest offset (C-LOOK), rather than the first I/O of
+ * the highest priority such class.  As in class order, the sweep is only
+ * followed within the 0.5 second interval of the oldest queued I/O of the
+ * class it lands on; otherwise that oldest I/O is issued instead.
  */
 
 /*
@@ -193,6 +214,34 @@ static uint_t zfs_vdev_nia_delay = 5;
  */
 static uint_t zfs_vdev_nia_credit = 5;
 
+/*
+ * When set, each vdev queue tries to keep the 99th percentile latency of
+ * sync reads (queue wait plus device service time) under this many
+ * microseconds by adjusting how many I/Os the other classes, except sync
+ * writes, may have active.  Every zfs_vdev_sync_read_target_window sync
+ * reads, or every second if there are fewer, the limits are halved if more
+ * than 1% of those reads missed the target, and raised by one, up to the
+ * class's own max_active, if none did.  The limits currently in effect are
+ * reported in /proc/spl/kstat/zfs/<pool>/vdev_queue.
+ */
+uint_t zfs_vdev_sync_read_target_us = 0;
+static uint_t zfs_vdev_sync_read_target_window = 200;
+
+/*
+ * On rotating media, once every class has its min_active outstanding, pick
+ * the next I/O from all classes still under their max_active in a single
+ * ascending offset sweep (C-LOOK) instead of class priority order.  This
+ * saves seeks for mixed workloads at the cost of priority between classes
+ * above their minimums.
+ */
+static uint_t zfs_vdev_elevator = 0;
+
+/*
+ * How many queued I/Os of classes already at their max_active the elevator
+ * will step over before falling back to class order.
+ */
+#define	VDQ_ELEVATOR_SCAN	32
+
 /*
  * To reduce IOPs, we aggregate small adjacent I/Os into one large I/O.
  * For read I/Os, we also aggregate across small adjacency gaps; for writes
@@ -275,8 +324,25 @@ vdev_queue_class_remove(vdev_queue_t *vq, zio_t *zio)
 	vq->vq_cqueued &= ~(empty << p);
 }
 
+/*
+ * Classes whose active limit is adjusted to meet the sync read latency target.
+ */
+static inline boolean_t
+vdev_queue_lt_class(zio_priority_t p)
+{
+	return (p != ZIO_PRIORITY_SYNC_READ && p != ZIO_PRIORITY_SYNC_WRITE);
+}
+
+static inline uint_t
+vdev_queue_lt_limit(vdev_queue_t *vq, zio_priority_t p, uint_t active)
+{
+	if (zfs_vdev_sync_read_target_us == 0 || !vdev_queue_lt_class(p))
+		return (active);
+	return (MIN(active, vq->vq_lt_limit[p]));
+}
+
 static uint_t
-vdev_queue_class_min_active(vdev_queue_t *vq, zio_priority_t p)
+vdev_queue_class_min_active_impl(vdev_queue_t *vq, zio_priority_t p)
 {
 	switch (p) {
 	case ZIO_PRIORITY_SYNC_READ:
@@ -307,6 +373,13 @@ vdev_queue_class_min_active(vdev_queue_t *vq, zio_priority_t p)
 	}
 }
 
+static uint_t
+vdev_queue_class_min_active(vdev_queue_t *vq, zio_priority_t p)
+{
+	return (vdev_queue_lt_limit(vq, p,
+	    vdev_queue_class_min_active_impl(vq, p)));
+}
+
 static uint_t
 vdev_queue_max_async_writes(spa_t *spa)
 {
@@ -354,7 +427,7 @@ vdev_queue_max_async_writes(spa_t *spa)
 }
 
 static uint_t
-vdev_queue_class_max_active(vdev_queue_t *vq, zio_priority_t p)
+vdev_queue_class_max_active_impl(vdev_queue_t *vq, zio_priority_t p)
 {
 	switch (p) {
 	case ZIO_PRIORITY_SYNC_READ:
@@ -401,6 +474,70 @@ vdev_queue_class_max_active(vdev_queue_t *vq, zio_priority_t p)
 	}
 }
 
+static uint_t
+vdev_queue_class_max_active(vdev_queue_t *vq, zio_priority_t p)
+{
+	return (vdev_queue_lt_limit(vq, p,
+	    vdev_queue_class_max_active_impl(vq, p)));
+}
+
+/*
+ * Account a completed I/O's queue wait and service time, and at the end of
+ * each window move the limits of the other classes according to how many
+ * sync reads missed zfs_vdev_sync_read_target_us.  Only the classes that
+ * were competing with the late reads are throttled, and nothing is throttled
+ * once there are no sync reads left to protect.
+ */
+static void
+vdev_queue_lt_update(vdev_queue_t *vq, zio_t *zio, hrtime_t now)
+{
+	zio_priority_t p = zio->io_priority;
+	hrtime_t wait = MAX(zio->io_delta - zio->io_delay, 0);
+
+	ASSERT(MUTEX_HELD(&vq->vq_lock));
+
+	vq->vq_lt_wait[p] = (vq->vq_lt_wait[p] * 7 + wait) / 8;
+	vq->vq_lt_service[p] = (vq->vq_lt_service[p] * 7 + zio->io_delay) / 8;
+
+	if (p == ZIO_PRIORITY_SYNC_READ) {
+		vq->vq_lt_reads++;
+		if (zio->io_delta > USEC2NSEC(zfs_vdev_sync_read_target_us)) {
+			vq->vq_lt_late++;
+			for (zio_priority_t c = 0;
+			    c < ZIO_PRIORITY_NUM_QUEUEABLE; c++) {
+				if (vq->vq_cactive[c] != 0)
+					vq->vq_lt_busy |= 1U << c;
+			}
+		}
+	}
+
+	if (vq->vq_lt_reads < zfs_vdev_sync_read_target_window &&
+	    now - vq->vq_lt_window_ts < NANOSEC)
+		return;
+
+	for (p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++) {
+		if (!vdev_queue_lt_class(p))
+			continue;
+
+		uint_t max = vdev_queue_class_max_active_impl(vq, p);
+		uint_t limit = MIN(vq->vq_lt_limit[p], max);
+		if (vq->vq_lt_reads == 0) {
+			limit = max;
+		} else if (vq->vq_lt_late * 100 > vq->vq_lt_reads) {
+			if (vq->vq_lt_busy & (1U << p))
+				limit = MAX(limit / 2, 1);
+		} else if (vq->vq_lt_late == 0 && limit < max) {
+			limit++;
+		}
+		vq->vq_lt_limit[p] = (limit >= max) ? UINT32_MAX : limit;
+	}
+
+	vq->vq_lt_reads = 0;
+	vq->vq_lt_late = 0;
+	vq->vq_lt_busy = 0;
+	vq->vq_lt_window_ts = now;
+}
+
 /*
  * Return the i/o class to issue from, or ZIO_PRIORITY_NUM_QUEUEABLE if
  * there is no eligible class.
@@ -475,6 +612,9 @@ vdev_queue_init(vdev_t *vd)
 	    offsetof(struct zio, io_offset_node));
 
 	vq->vq_last_offset = 0;
+	for (p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++)
+		vq->vq_lt_limit[p] = UINT32_MAX;
+	vq->vq_lt_window_ts = gethrtime();
 	list_create(&vq->vq_active_list, sizeof (struct zio),
 	    offsetof(struct zio, io_queue_node.l));
 	mutex_init(&vq->vq_lock, NULL, MUTEX_DEFAULT, NULL);
@@ -759,7 +899,10 @@ vdev_queue_aggregate(vdev_queue_t *vq, zio_t *zio)
 		dio = nio;
 		nio = AVL_NEXT(t, dio);
 		ASSERT3P(dio, !=, NULL);
-		zio_add_child(dio, aio);
+		if (dio == first)
+			zio_add_child_first(dio, aio);
+		else
+			zio_add_child(dio, aio);
 		vdev_queue_io_remove(vq, dio);
 
 		if (dio->io_offset != next_offset) {
@@ -808,6 +951,84 @@ vdev_queue_aggregate(vdev_queue_t *vq, zio_t *zio)
 	return (aio);
 }
 
+/*
+ * Return the first I/O at or after offset off whose class is in cmask,
+ * looking at no more than VDQ_ELEVATOR_SCAN I/Os of other classes.
+ */
+static zio_t *
+vdev_queue_elevator_find(vdev_queue_t *vq, avl_tree_t *tree, uint64_t off,
+    uint32_t cmask)
+{
+	zio_t *zio, *prev;
+	avl_index_t idx;
+
+	vq->vq_io_search.io_offset = off;
+	zio = avl_find(tree, &vq->vq_io_search, &idx);
+	if (zio == NULL)
+		zio = avl_nearest(tree, idx, AVL_AFTER);
+
+	/* I/Os at the same offset may sort before the search node. */
+	while ((prev = (zio != NULL ? AVL_PREV(tree, zio) :
+	    avl_last(tree))) != NULL && prev->io_offset >= off)
+		zio = prev;
+
+	for (int i = 0; zio != NULL && i < VDQ_ELEVATOR_SCAN; i++) {
+		if (cmask & (1U << zio->io_priority))
+			return (zio);
+		zio = AVL_NEXT(tree, zio);
+	}
+	return (NULL);
+}
+
+/*
+ * C-LOOK across the read and write offset trees: the nearest eligible I/O
+ * at or after the last issued offset, or if there is none, the lowest.  To
+ * avoid starvation, an I/O queued in a later interval than the oldest I/O
+ * of its class is passed over for that oldest I/O.
+ */
+static zio_t *
+vdev_queue_elevator_next(vdev_queue_t *vq)
+{
+	uint64_t off = vq->vq_last_offset;
+	uint32_t cmask = 0;
+	zio_t *rio, *wio, *zio, *oldest;
+	zio_priority_t p;
+
+	for (zio_priority_t p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++) {
+		if ((vq->vq_cqueued & (1U << p)) != 0 && vq->vq_cactive[p] <
+		    vdev_queue_class_max_active(vq, p))
+			cmask |= 1U << p;
+	}
+
+again:
+	rio = vdev_queue_elevator_find(vq, &vq->vq_read_offset_tree, off,
+	    cmask);
+	wio = vdev_queue_elevator_find(vq, &vq->vq_write_offset_tree, off,
+	    cmask);
+	if (rio == NULL && wio == NULL && off != 0) {
+		off = 0;
+		goto again;
+	}
+
+	if (rio == NULL || (wio != NULL && wio->io_offset < rio->io_offset))
+		zio = wio;
+	else
+		zio = rio;
+	if (zio == NULL)
+		return (NULL);
+
+	p = zio->io_priority;
+	if (vdev_queue_class_fifo(p))
+		oldest = list_head(&vq->vq_class[p].vqc_list);
+	else
+		oldest = avl_first(&vq->vq_class[p].vqc_tree);
+	if ((zio->io_timestamp >> VDQ_T_SHIFT) !=
+	    (oldest->io_timestamp >> VDQ_T_SHIFT))
+		zio = oldest;
+
+	return (zio);
+}
+
 static zio_t *
 vdev_queue_io_to_issue(vdev_queue_t *vq)
 {
@@ -826,7 +1047,17 @@ again:
 		return (NULL);
 	}
 
-	if (vdev_queue_class_fifo(p)) {
+	/*
+	 * A class at or above its minimum was only chosen because all
+	 * minimums are met, so let the elevator pick among the classes
+	 * under their maximum instead.
+	 */
+	zio = NULL;
+	if (zfs_vdev_elevator && !vq->vq_vdev->vdev_nonrot &&
+	    vq->vq_cactive[p] >= vdev_queue_class_min_active(vq, p) &&
+	    (zio = vdev_queue_elevator_next(vq)) != NULL) {
+		p = vq->vq_last_prio = zio->io_priority;
+	} else if (vdev_queue_class_fifo(p)) {
 		zio = list_head(&vq->vq_class[p].vqc_list);
 	} else {
 		/*
@@ -997,6 +1228,8 @@ vdev_queue_io_done(zio_t *zio)
 
 	mutex_enter(&vq->vq_lock);
 	vdev_queue_pending_remove(vq, zio);
+	if (zfs_vdev_sync_read_target_us != 0)
+		vdev_queue_lt_update(vq, zio, now);
 
 	while ((nio = vdev_queue_io_to_issue(vq)) != NULL) {
 		mutex_exit(&vq->vq_lock);
@@ -1104,6 +1337,16 @@ vdev_queue_class_length(vdev_t *vd, zio_priority_t p)
 		return (avl_numnodes(&vq->vq_class[p].vqc_tree));
 }
 
+/*
+ * The number of I/Os of a class that may currently be active, after any
+ * adjustment for the sync read latency target.  Lock free, for kstats.
+ */
+uint_t
+vdev_queue_class_limit(vdev_t *vd, zio_priority_t p)
+{
+	return (vdev_queue_class_max_active(&vd->vdev_queue, p));
+}
+
 ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, aggregation_limit, UINT, ZMOD_RW,
 	"Max vdev I/O aggregation size");
 
@@ -1182,5 +1425,14 @@ ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, rebuild_min_active, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, nia_credit, UINT, ZMOD_RW,
 	"Number of non-interactive I/Os to allow in sequence");
 
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, sync_read_target_us, UINT, ZMOD_RW,
+	"Target p99 sync read latency per vdev, adjusting other class limits");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, sync_read_target_window, UINT, ZMOD_RW,
+	"Sync reads per sync read latency target adjustment");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, elevator, UINT, ZMOD_RW,
+	"Issue I/Os above class minimums in offset order on rotating media");
+
 ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, nia_delay, UINT, ZMOD_RW,
 	"Number of non-interactive I/Os before _max_active");
@@ -98,6 +98,27 @@ static int zfs_dio_enabled = 1;
  */
 static int zfs_dio_strict = 0;
 
+/*
+ * Write the parts of blocks not fully covered by a Direct I/O write with
+ * Direct I/O as well, by reading the rest of each block around the ARC and
+ * rewriting the whole block.  Otherwise those parts go through the ARC.
+ */
+static int zfs_dio_rmw = 0;
+
+/*
+ * Let asynchronous callers (AIO, io_uring) have Direct I/O reads complete
+ * without blocking the submitting thread, see zfs_read_async().
+ */
+static int zfs_dio_async = 1;
+
+/*
+ * Bytes from the start of each file or directory returned by zfs_readdir()
+ * to prefetch, while lookups in the directory keep its z_zn_prefetch set.
+ * This lets small-file scans (backups, rsync) read ahead across files, at
+ * the cost of waiting for the entries' dnodes in readdir.  0 only
+ * prefetches the dnodes.
+ */
+uint64_t zfs_readdir_prefetch_bytes = 0;
 
 /*
  * Maximum bytes to read per chunk in zfs_read().
@@ -201,6 +222,19 @@ zfs_holey(znode_t *zp, ulong_t cmd, loff_t *off)
 }
 #endif /* SEEK_HOLE && SEEK_DATA */
 
+/*
+ * Prefetch the first zfs_readdir_prefetch_bytes of the given objects.  This
+ * waits for their dnodes, which zfs_readdir() has prefetched already.
+ */
+void
+zfs_readdir_prefetch(objset_t *os, const uint64_t *objs, uint_t count)
+{
+	for (uint_t i = 0; i < count; i++) {
+		dmu_prefetch(os, objs[i], 0, 0, zfs_readdir_prefetch_bytes,
+		    ZIO_PRIORITY_ASYNC_READ);
+	}
+}
+
 int
 zfs_access(znode_t *zp, int mode, int flag, cred_t *cr)
 {
@@ -282,10 +316,12 @@ zfs_setup_direct(struct znode *zp, zfs_uio_t *uio, zfs_uio_rw_t rw,
 	}
 
 	/*
-	 * For short writes the page mapping of Direct I/O makes no sense.
-	 * Direct them through the ARC as uncached I/O.
+	 * For short writes the page mapping of Direct I/O makes no sense,
+	 * unless they are merged into their blocks by zfs_write().  Direct
+	 * them through the ARC as uncached I/O.
 	 */
-	if (rw == UIO_WRITE && zfs_uio_resid(uio) < zp->z_blksz)
+	if (rw == UIO_WRITE && zfs_uio_resid(uio) < zp->z_blksz &&
+	    (!zfs_dio_rmw || (ioflag & O_APPEND)))
 		goto out;
 
 	error = zfs_uio_get_dio_pages_alloc(uio, rw);
@@ -538,6 +574,174 @@ out:
 	return (error);
 }
 
+/*
+ * A Direct I/O read started by zfs_read_async().  It keeps the range lock
+ * and the user pages until the read completes.
+ */
+typedef struct zfs_read_async {
+	znode_t			*zra_zp;
+	zfs_locked_range_t	*zra_lr;
+	zfs_uio_t		zra_uio;	/* holds the user pages */
+	abd_t			*zra_data;
+	uint64_t		zra_offset;
+	uint64_t		zra_size;
+	dmu_flags_t		zra_flags;
+	boolean_t		zra_failed;	/* not issued, no callback */
+	zfs_read_done_t		*zra_done;
+	void			*zra_arg;
+	taskq_ent_t		zra_tqent;	/* for zfs_read_async_retry() */
+} zfs_read_async_t;
+
+static void
+zfs_read_async_finish(zfs_read_async_t *zra, int error)
+{
+	zfsvfs_t *zfsvfs = ZTOZSB(zra->zra_zp);
+
+	abd_free(zra->zra_data);
+	zfs_rangelock_exit(zra->zra_lr);
+	zfs_uio_free_dio_pages(&zra->zra_uio, UIO_READ);
+	if (error == 0) {
+		dataset_kstats_update_read_kstats(&zfsvfs->z_kstat,
+		    zra->zra_size);
+	}
+	zra->zra_done(zra->zra_arg, error, error == 0 ? zra->zra_size : 0);
+	kmem_free(zra, sizeof (*zra));
+}
+
+/*
+ * As in zfs_read(), a Direct I/O read that failed its checksum is treated
+ * as suspicious and read again through the ARC.  This may block, so it is
+ * not done from the zio completion.
+ */
+static void
+zfs_read_async_retry(void *arg)
+{
+	zfs_read_async_t *zra = arg;
+	znode_t *zp = zra->zra_zp;
+	zfsvfs_t *zfsvfs = ZTOZSB(zp);
+	int error;
+
+	if ((error = zfs_enter_verify_zp(zfsvfs, zp, FTAG)) == 0) {
+		error = dmu_read_abd_dbuf_cached(sa_get_db(zp->z_sa_hdl),
+		    zra->zra_offset, zra->zra_size, zra->zra_data,
+		    zra->zra_flags);
+		if (error == ECKSUM)
+			error = SET_ERROR(EIO);
+		zfs_exit(zfsvfs, FTAG);
+	}
+	zfs_read_async_finish(zra, error);
+}
+
+static void
+zfs_read_async_done(zio_t *zio)
+{
+	zfs_read_async_t *zra = zio->io_private;
+
+	if (zra->zra_failed)
+		return;
+
+	if (zio->io_error == ECKSUM) {
+		taskq_dispatch_ent(system_taskq, zfs_read_async_retry, zra, 0,
+		    &zra->zra_tqent);
+		return;
+	}
+	zfs_read_async_finish(zra, zio->io_error);
+}
+
+/*
+ * Start a Direct I/O read of the whole uio, and return without waiting for
+ * it.  Once it completes, done(arg, error, nread) is called from the zio
+ * completion or a taskq thread.  Requests that zfs_read() would not handle
+ * as a single page-aligned Direct I/O read within the file, or that would
+ * need to block here, return EAGAIN without side effects, for the caller to
+ * fall back to zfs_read().  Any other error is final.
+ */
+int
+zfs_read_async(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr,
+    zfs_read_done_t *done, void *arg)
+{
+	(void) cr;
+	zfsvfs_t *zfsvfs = ZTOZSB(zp);
+	offset_t offset = zfs_uio_offset(uio);
+	ssize_t size = zfs_uio_resid(uio);
+	boolean_t frsync = B_FALSE;
+	int error;
+
+	if (!zfs_dio_async)
+		return (SET_ERROR(EAGAIN));
+
+	if ((error = zfs_enter_verify_zp(zfsvfs, zp, FTAG)) != 0)
+		return (error);
+
+#ifdef FRSYNC
+	frsync = !!(ioflag & FRSYNC);
+#endif
+	if ((zp->z_pflags & ZFS_AV_QUARANTINED) || Z_ISDIR(ZTOTYPE(zp)) ||
+	    offset < 0 || size == 0 || size > DMU_MAX_ACCESS ||
+	    (zfsvfs->z_log &&
+	    (frsync || zfsvfs->z_os->os_sync == ZFS_SYNC_ALWAYS))) {
+		zfs_exit(zfsvfs, FTAG);
+		return (SET_ERROR(EAGAIN));
+	}
+
+	zfs_locked_range_t *lr = zfs_rangelock_tryenter(&zp->z_rangelock,
+	    offset, size, RL_READER);
+	if (lr == NULL) {
+		zfs_exit(zfsvfs, FTAG);
+		return (SET_ERROR(EAGAIN));
+	}
+
+	/* Reads reaching the end of file are left to zfs_read(). */
+	if (offset + size > zp->z_size) {
+		error = SET_ERROR(EAGAIN);
+		goto out;
+	}
+
+	error = zfs_setup_direct(zp, uio, UIO_READ, &ioflag);
+	if (error != 0)
+		goto out;
+	if (!(uio->uio_extflg & UIO_DIRECT)) {
+		error = SET_ERROR(EAGAIN);
+		goto out;
+	}
+
+	zfs_read_async_t *zra = kmem_zalloc(sizeof (*zra), KM_SLEEP);
+	zra->zra_zp = zp;
+	zra->zra_lr = lr;
+	zra->zra_uio = *uio;
+	zra->zra_data = abd_alloc_from_pages(uio->uio_dio.pages,
+	    offset & (PAGESIZE - 1), size);
+	zra->zra_offset = offset;
+	zra->zra_size = size;
+	zra->zra_flags = DMU_READ_PREFETCH | DMU_UNCACHEDIO | DMU_DIRECTIO;
+	zra->zra_done = done;
+	zra->zra_arg = arg;
+	taskq_init_ent(&zra->zra_tqent);
+
+	zio_t *rio = zio_root(zfsvfs->z_os->os_spa, zfs_read_async_done, zra,
+	    ZIO_FLAG_CANFAIL);
+	error = dmu_read_abd_dbuf_nowait(sa_get_db(zp->z_sa_hdl), offset,
+	    size, zra->zra_data, zra->zra_flags, rio);
+	if (error != 0) {
+		zra->zra_failed = B_TRUE;
+		(void) zio_wait(rio);
+		abd_free(zra->zra_data);
+		zfs_uio_free_dio_pages(uio, UIO_READ);
+		kmem_free(zra, sizeof (*zra));
+		goto out;
+	}
+
+	ZFS_ACCESSTIME_STAMP(zfsvfs, zp);
+	zfs_exit(zfsvfs, FTAG);
+	zio_nowait(rio);
+	return (0);
+
+out:
+	zfs_rangelock_exit(lr);
+	zfs_exit(zfsvfs, FTAG);
+	return (error);
+}
+
 static void
 zfs_clear_setid_bits_if_necessary(zfsvfs_t *zfsvfs, znode_t *zp, cred_t *cr,
     uint64_t *clear_setid_bits_txgp, dmu_tx_t *tx)
@@ -682,6 +886,14 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 		return (SET_ERROR(error));
 	}
 
+	/*
+	 * Parts of blocks may be merged with Direct I/O, see
+	 * dmu_write_uio_direct_rmw().  Appending writes don't know their
+	 * blocks before taking the range lock, and always use the ARC.
+	 */
+	boolean_t dio_rmw = zfs_dio_rmw && (uio->uio_extflg & UIO_DIRECT) &&
+	    !(ioflag & O_APPEND);
+
 	/*
 	 * Pre-fault the pages to ensure slow (eg NFS) pages
 	 * don't hold up txg.
@@ -718,6 +930,16 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 		 * layers.
 		 */
 		zfs_uio_setsoffset(uio, woff);
+	} else if (dio_rmw && ISP2(zp->z_blksz)) {
+		/*
+		 * A Direct I/O read-modify-write rewrites whole blocks, so
+		 * lock all of the blocks touched by this write.
+		 */
+		uint64_t blksz = zp->z_blksz;
+		uint64_t start = P2ALIGN_TYPED(woff, blksz, uint64_t);
+		lr = zfs_rangelock_enter(&zp->z_rangelock, start,
+		    P2ROUNDUP_TYPED(woff + n, blksz, uint64_t) - start,
+		    RL_WRITER);
 	} else {
 		/*
 		 * Note that if the file block size will change as a result of
@@ -883,7 +1105,15 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 		 */
 		if (lr->lr_length == UINT64_MAX) {
 			zfs_grow_blocksize(zp, blksz, tx);
-			zfs_rangelock_reduce(lr, woff, n);
+			if (dio_rmw && ISP2(zp->z_blksz)) {
+				uint64_t start = P2ALIGN_TYPED(woff,
+				    zp->z_blksz, uint64_t);
+				zfs_rangelock_reduce(lr, start,
+				    P2ROUNDUP_TYPED(woff + n, zp->z_blksz,
+				    uint64_t) - start);
+			} else {
+				zfs_rangelock_reduce(lr, woff, n);
+			}
 		}
 
 		dmu_flags_t dflags = DMU_READ_PREFETCH;
@@ -891,6 +1121,12 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 			dflags |= DMU_UNCACHEDIO;
 		if (uio->uio_extflg & UIO_DIRECT)
 			dflags |= DMU_DIRECTIO;
+		if ((uio->uio_extflg & UIO_DIRECT) && dio_rmw &&
+		    ISP2(zp->z_blksz) && lr->lr_offset <=
+		    P2ALIGN_TYPED(woff, zp->z_blksz, uint64_t) &&
+		    lr->lr_offset + lr->lr_length >=
+		    P2ROUNDUP_TYPED(woff + nbytes, zp->z_blksz, uint64_t))
+			dflags |= DMU_DIRECTIO_RMW;
 
 		ssize_t tx_bytes;
 		if (abuf == NULL) {
@@ -2153,6 +2389,7 @@ EXPORT_SYMBOL(zfs_access);
 EXPORT_SYMBOL(zfs_fsync);
 EXPORT_SYMBOL(zfs_holey);
 EXPORT_SYMBOL(zfs_read);
+EXPORT_SYMBOL(zfs_read_async);
 EXPORT_SYMBOL(zfs_write);
 EXPORT_SYMBOL(zfs_getsecattr);
 EXPORT_SYMBOL(zfs_setsecattr);
@@ -2176,3 +2413,12 @@ ZFS_MODULE_PARAM(zfs, zfs_, dio_enabled, INT, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs, zfs_, dio_strict, INT, ZMOD_RW,
 	"Return errors on misaligned Direct I/O");
+
+ZFS_MODULE_PARAM(zfs, zfs_, dio_rmw, INT, ZMOD_RW,
+	"Merge partial block Direct I/O writes without caching the block");
+
+ZFS_MODULE_PARAM(zfs, zfs_, dio_async, INT, ZMOD_RW,
+	"Complete asynchronous Direct I/O reads without blocking");
+
+ZFS_MODULE_PARAM(zfs, zfs_, readdir_prefetch_bytes, U64, ZMOD_RW,
+	"Bytes of each directory entry's data to prefetch in readdir");
@@ -140,6 +140,14 @@ static uint_t zfs_sync_pass_rewrite = 2;
 int zio_exclude_metadata = 0;
 static int zio_requeue_io_start_cut_in_line = 1;
 
+/*
+ * On pools built entirely from non-rotational devices, completions of
+ * uncompressed, unencrypted reads of at most this many bytes are handed
+ * directly to the thread blocked in zio_wait() instead of being bounced
+ * through the interrupt taskq.  Zero disables the inline path.
+ */
+static uint_t zio_inline_read_max = 0;
+
 #ifdef ZFS_DEBUG
 static const int zio_buf_debug_limit = 16384;
 #else
@@ -151,6 +159,10 @@ typedef struct zio_stats {
 	kstat_named_t ziostat_alloc_class_fallbacks;
 	kstat_named_t ziostat_gang_writes;
 	kstat_named_t ziostat_gang_multilevel;
+	kstat_named_t ziostat_zio_allocations;
+	kstat_named_t ziostat_link_allocations;
+	kstat_named_t ziostat_logical_ios;
+	kstat_named_t ziostat_inline_completions;
 } zio_stats_t;
 
 static zio_stats_t zio_stats = {
@@ -158,6 +170,10 @@ static zio_stats_t zio_stats = {
 	{ "alloc_class_fallbacks",	KSTAT_DATA_UINT64 },
 	{ "gang_writes",	KSTAT_DATA_UINT64 },
 	{ "gang_multilevel",	KSTAT_DATA_UINT64 },
+	{ "zio_allocations",	KSTAT_DATA_UINT64 },
+	{ "link_allocations",	KSTAT_DATA_UINT64 },
+	{ "logical_ios",	KSTAT_DATA_UINT64 },
+	{ "inline_completions",	KSTAT_DATA_UINT64 },
 };
 
 struct {
@@ -165,6 +181,10 @@ struct {
 	wmsum_t ziostat_alloc_class_fallbacks;
 	wmsum_t ziostat_gang_writes;
 	wmsum_t ziostat_gang_multilevel;
+	wmsum_t ziostat_zio_allocations;
+	wmsum_t ziostat_link_allocations;
+	wmsum_t ziostat_logical_ios;
+	wmsum_t ziostat_inline_completions;
 } ziostat_sums;
 
 #define	ZIOSTAT_BUMP(stat)	wmsum_add(&ziostat_sums.stat, 1);
@@ -190,6 +210,14 @@ zio_kstats_update(kstat_t *ksp, int rw)
 	    wmsum_value(&ziostat_sums.ziostat_gang_writes);
 	zs->ziostat_gang_multilevel.value.ui64 =
 	    wmsum_value(&ziostat_sums.ziostat_gang_multilevel);
+	zs->ziostat_zio_allocations.value.ui64 =
+	    wmsum_value(&ziostat_sums.ziostat_zio_allocations);
+	zs->ziostat_link_allocations.value.ui64 =
+	    wmsum_value(&ziostat_sums.ziostat_link_allocations);
+	zs->ziostat_logical_ios.value.ui64 =
+	    wmsum_value(&ziostat_sums.ziostat_logical_ios);
+	zs->ziostat_inline_completions.value.ui64 =
+	    wmsum_value(&ziostat_sums.ziostat_inline_completions);
 	return (0);
 }
 
@@ -207,6 +235,10 @@ zio_init(void)
 	wmsum_init(&ziostat_sums.ziostat_alloc_class_fallbacks, 0);
 	wmsum_init(&ziostat_sums.ziostat_gang_writes, 0);
 	wmsum_init(&ziostat_sums.ziostat_gang_multilevel, 0);
+	wmsum_init(&ziostat_sums.ziostat_zio_allocations, 0);
+	wmsum_init(&ziostat_sums.ziostat_link_allocations, 0);
+	wmsum_init(&ziostat_sums.ziostat_logical_ios, 0);
+	wmsum_init(&ziostat_sums.ziostat_inline_completions, 0);
 	zio_ksp = kstat_create("zfs", 0, "zio_stats",
 	    "misc", KSTAT_TYPE_NAMED, sizeof (zio_stats) /
 	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
@@ -352,6 +384,9 @@ zio_fini(void)
 	wmsum_fini(&ziostat_sums.ziostat_alloc_class_fallbacks);
 	wmsum_fini(&ziostat_sums.ziostat_gang_writes);
 	wmsum_fini(&ziostat_sums.ziostat_gang_multilevel);
+	wmsum_fini(&ziostat_sums.ziostat_zio_allocations);
+	wmsum_fini(&ziostat_sums.ziostat_link_allocations);
+	wmsum_fini(&ziostat_sums.ziostat_logical_ios);
 
 	kmem_cache_destroy(zio_link_cache);
 	kmem_cache_destroy(zio_cache);
@@ -762,7 +797,18 @@ zio_add_child_impl(zio_t *pio, zio_t *cio, boolean_t first)
 	    (cio->io_child_type != ZIO_CHILD_VDEV),
 	    (pio->io_pipeline & ZIO_STAGE_READY) == 0);
 
-	zio_link_t *zl = kmem_cache_alloc(zio_link_cache, KM_SLEEP);
+	/*
+	 * Most zios only ever have one parent, so the link to their first
+	 * one is embedded in the child.  Only further parents, e.g. those
+	 * of aggregated I/Os, need a link allocated.
+	 */
+	zio_link_t *zl;
+	if (first) {
+		zl = &cio->io_parent_link;
+	} else {
+		zl = kmem_cache_alloc(zio_link_cache, KM_SLEEP);
+		ZIOSTAT_BUMP(ziostat_link_allocations);
+	}
 	zl->zl_parent = pio;
 	zl->zl_child = cio;
 
@@ -794,7 +840,11 @@ zio_add_child(zio_t *pio, zio_t *cio)
 	zio_add_child_impl(pio, cio, B_FALSE);
 }
 
-static void
+/*
+ * Add the first parent of a zio that no one else can reach yet.  Its link is
+ * embedded in the child.
+ */
+void
 zio_add_child_first(zio_t *pio, zio_t *cio)
 {
 	zio_add_child_impl(pio, cio, B_TRUE);
@@ -814,7 +864,8 @@ zio_remove_child(zio_t *pio, zio_t *cio, zio_link_t *zl)
 
 	mutex_exit(&cio->io_lock);
 	mutex_exit(&pio->io_lock);
-	kmem_cache_free(zio_link_cache, zl);
+	if (zl != &cio->io_parent_link)
+		kmem_cache_free(zio_link_cache, zl);
 }
 
 static boolean_t
@@ -961,6 +1012,7 @@ zio_create(zio_t *pio, spa_t *spa, uint64_t txg, const blkptr_t *bp,
 
 	zio = kmem_cache_alloc(zio_cache, KM_SLEEP);
 	memset(zio, 0, sizeof (zio_t));
+	ZIOSTAT_BUMP(ziostat_zio_allocations);
 
 	mutex_init(&zio->io_lock, NULL, MUTEX_NOLOCKDEP, NULL);
 	cv_init(&zio->io_cv, NULL, CV_DEFAULT, NULL);
@@ -980,6 +1032,9 @@ zio_create(zio_t *pio, spa_t *spa, uint64_t txg, const blkptr_t *bp,
 	else
 		zio->io_child_type = ZIO_CHILD_LOGICAL;
 
+	if (bp != NULL && zio->io_child_type == ZIO_CHILD_LOGICAL)
+		ZIOSTAT_BUMP(ziostat_logical_ios);
+
 	if (bp != NULL) {
 		if (type != ZIO_TYPE_WRITE ||
 		    zio->io_child_type == ZIO_CHILD_DDT) {
@@ -1015,6 +1070,8 @@ zio_create(zio_t *pio, spa_t *spa, uint64_t txg, const blkptr_t *bp,
 	zio->io_orig_pipeline = zio->io_pipeline = pipeline;
 	zio->io_pipeline_trace = ZIO_STAGE_OPEN;
 	zio->io_allocator = ZIO_ALLOCATOR_NONE;
+	zio->io_node = (pio != NULL) ? pio->io_node : CPU_NODEID;
+	zio->io_inline_root = (pio != NULL) ? pio->io_inline_root : zio;
 
 	zio->io_state[ZIO_WAIT_READY] = (stage >= ZIO_STAGE_READY) ||
 	    (pipeline & ZIO_STAGE_READY) == 0;
@@ -1641,12 +1698,17 @@ zio_vdev_child_io(zio_t *pio, blkptr_t *bp, vdev_t *vd, uint64_t offset,
 		 */
 		ASSERT0(pio->io_post & ZIO_POST_DIO_CHKSUM_ERR);
 	} else if (type == ZIO_TYPE_WRITE &&
-	    pio->io_prop.zp_direct_write == B_TRUE) {
+	    pio->io_prop.zp_direct_write == B_TRUE &&
+	    pio->io_abd == pio->io_orig_abd) {
 		/*
 		 * By default we only will verify checksums for Direct I/O
 		 * writes for Linux. FreeBSD is able to place user pages under
 		 * write protection before issuing them to the ZIO pipeline.
 		 *
+		 * Once the data was compressed or encrypted, the checksummed
+		 * and written buffer is our own copy rather than the user
+		 * pages, which can't change under us, so it is not verified.
+		 *
 		 * Checksum validation errors will only be reported through
 		 * the top-level VDEV, which is set by this child ZIO.
 		 */
@@ -2218,9 +2280,125 @@ zio_issue_async(zio_t *zio)
 	return (NULL);
 }
 
+/*
+ * A completion may be run by the thread waiting on its root when that
+ * thread is sleeping in zio_wait() anyway and the remaining stages are
+ * cheap: a small read with no decompression or decryption to do.
+ */
+static boolean_t
+zio_inline_eligible(zio_t *zio)
+{
+	zio_t *lio = zio->io_logical;
+
+	if (!zio->io_inline_root->io_inline || zio->io_type != ZIO_TYPE_READ)
+		return (B_FALSE);
+
+	if (lio == NULL || lio->io_bp == NULL ||
+	    lio->io_size > zio_inline_read_max)
+		return (B_FALSE);
+
+	return (BP_GET_COMPRESS(lio->io_bp) == ZIO_COMPRESS_OFF &&
+	    !BP_USES_CRYPT(lio->io_bp));
+}
+
+/*
+ * Hand a completed zio to the waiter on its root.  The root can't complete,
+ * and so can't be freed by zio_wait(), before the waiter has run this zio,
+ * so it is safe to use until we drop its io_lock.
+ */
+static void
+zio_inline_handoff(zio_t *zio)
+{
+	zio_t *root = zio->io_inline_root;
+
+	mutex_enter(&root->io_lock);
+	zio->io_inline_queued = B_TRUE;
+	zio->io_inline_next = root->io_inline_list;
+	root->io_inline_list = zio;
+	cv_broadcast(&root->io_cv);
+	mutex_exit(&root->io_lock);
+}
+
+/*
+ * Called by zio_wait() with io_lock held to run the completions handed to it.
+ * The lock is dropped while they run.
+ */
+static void
+zio_inline_drain(zio_t *root)
+{
+	zio_t *zio, *next;
+
+	ASSERT(MUTEX_HELD(&root->io_lock));
+	zio = root->io_inline_list;
+	root->io_inline_list = NULL;
+	mutex_exit(&root->io_lock);
+
+	for (; zio != NULL; zio = next) {
+		next = zio->io_inline_next;
+		zio->io_inline_next = NULL;
+		zio->io_inline_queued = B_FALSE;
+		ZIOSTAT_BUMP(ziostat_inline_completions);
+		zio_execute(zio);
+	}
+
+	mutex_enter(&root->io_lock);
+}
+
+/*
+ * Only small synchronous reads are worth completing on the waiter: either
+ * the zio waited on is one, or it is a root whose children all are.
+ */
+static boolean_t
+zio_inline_armable(zio_t *zio)
+{
+	zio_link_t *zl = NULL;
+	zio_t *cio;
+	boolean_t armable = B_FALSE;
+
+	if (zio->io_type == ZIO_TYPE_READ) {
+		return (zio->io_priority == ZIO_PRIORITY_SYNC_READ &&
+		    zio->io_size <= zio_inline_read_max);
+	}
+	if (zio->io_type != ZIO_TYPE_NULL)
+		return (B_FALSE);
+
+	mutex_enter(&zio->io_lock);
+	while ((cio = zio_walk_children(zio, &zl)) != NULL) {
+		armable = (cio->io_type == ZIO_TYPE_READ &&
+		    cio->io_priority == ZIO_PRIORITY_SYNC_READ &&
+		    cio->io_size <= zio_inline_read_max);
+		if (!armable)
+			break;
+	}
+	mutex_exit(&zio->io_lock);
+
+	return (armable);
+}
+
+/*
+ * Called by vdevs that complete I/O in a thread which may block, instead of
+ * in interrupt context: the submitting thread of a polled or waited-for
+ * disk I/O, or a vdev_file taskq thread.  If the waiter on the zio's root
+ * can run the completion, hand it over and return B_TRUE.  Otherwise the
+ * caller completes the zio as it would have.  zio_interrupt() never hands
+ * off, as it may run in interrupt context, or with a root's io_lock held
+ * by the deadman.
+ */
+boolean_t
+zio_inline_complete(zio_t *zio)
+{
+	if (!zio_inline_eligible(zio))
+		return (B_FALSE);
+
+	zio_inline_handoff(zio);
+	return (B_TRUE);
+}
+
 void
-zio_interrupt(void *zio)
+zio_interrupt(void *arg)
 {
+	zio_t *zio = arg;
+
 	zio_taskq_dispatch(zio, ZIO_TASKQ_INTERRUPT, B_FALSE);
 }
 
@@ -2324,10 +2502,14 @@ zio_deadman_impl(zio_t *pio, int ziodepth)
 	if (vd != NULL && vd->vdev_ops->vdev_op_leaf &&
 	    list_is_empty(&pio->io_child_list) &&
 	    failmode == ZIO_FAILURE_MODE_CONTINUE &&
-	    taskq_empty_ent(&pio->io_tqent) &&
+	    taskq_empty_ent(&pio->io_tqent) && !pio->io_inline_queued &&
 	    pio->io_queue_state == ZIO_QS_ACTIVE) {
+		/*
+		 * The root's io_lock may be held above us, so this must go
+		 * to the taskq rather than to the waiter on the root.
+		 */
 		pio->io_error = EINTR;
-		zio_interrupt(pio);
+		zio_taskq_dispatch(pio, ZIO_TASKQ_INTERRUPT, B_FALSE);
 	}
 
 	mutex_enter(&pio->io_lock);
@@ -2521,15 +2703,25 @@ zio_wait(zio_t *zio)
 	ASSERT0(zio->io_queued_timestamp);
 	zio->io_queued_timestamp = gethrtime();
 
+	vdev_t *rvd = zio->io_spa->spa_root_vdev;
+	if (zio_inline_read_max != 0 && zio->io_inline_root == zio &&
+	    rvd != NULL && rvd->vdev_nonrot && zio_inline_armable(zio))
+		zio->io_inline = B_TRUE;
+
 	if (zio->io_type == ZIO_TYPE_WRITE) {
 		spa_select_allocator(zio);
 	}
 	__zio_execute(zio);
 
 	mutex_enter(&zio->io_lock);
+	clock_t deadline = ddi_get_lbolt() + timeout;
 	while (zio->io_executor != NULL) {
-		error = cv_timedwait_io(&zio->io_cv, &zio->io_lock,
-		    ddi_get_lbolt() + timeout);
+		if (zio->io_inline_list != NULL) {
+			zio_inline_drain(zio);
+			continue;
+		}
+
+		error = cv_timedwait_io(&zio->io_cv, &zio->io_lock, deadline);
 
 		if (zfs_deadman_enabled && error == -1 &&
 		    gethrtime() - zio->io_queued_timestamp >
@@ -2539,6 +2731,8 @@ zio_wait(zio_t *zio)
 			zio_deadman(zio, FTAG);
 			mutex_enter(&zio->io_lock);
 		}
+		if (error == -1)
+			deadline = ddi_get_lbolt() + timeout;
 	}
 	mutex_exit(&zio->io_lock);
 
@@ -2571,7 +2765,7 @@ zio_nowait(zio_t *zio)
 		spa_t *spa = zio->io_spa;
 		pio = spa->spa_async_zio_root[CPU_SEQID_UNSTABLE];
 
-		zio_add_child(pio, zio);
+		zio_add_child_first(pio, zio);
 	}
 
 	ASSERT0(zio->io_queued_timestamp);
@@ -6210,6 +6404,9 @@ ZFS_MODULE_PARAM(zfs_zio, zio_, slow_io_ms, INT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_zio, zio_, requeue_io_start_cut_in_line, INT, ZMOD_RW,
 	"Prioritize requeued I/O");
 
+ZFS_MODULE_PARAM(zfs_zio, zio_, inline_read_max, UINT, ZMOD_RW,
+	"Max size of reads completed by the waiting thread on SSD pools");
+
 ZFS_MODULE_PARAM(zfs, zfs_, sync_pass_deferred_free,  UINT, ZMOD_RW,
 	"Defer frees starting in this pass");
 